@@ -33,7 +33,7 @@ using namespace compoGM;
 
 struct M0 : public Composite {
     static void contents(
-        Model& m, IndexSet& experiments, IndexSet& samples, map<string, map<string, int>>& data) {
+        Model& m, IndexSet& experiments, IndexSet& samples, IndexedMatrix<int>& data) {
         m.component<OrphanExp>("alpha", 1, 1);
         m.component<OrphanExp>("mu", 1, 1);
 
@@ -41,7 +41,7 @@ struct M0 : public Composite {
             .connect<ArrayToValue>("a", "alpha")
             .connect<ArrayToValue>("b", "mu");
 
-        m.component<Matrix<Poisson>>("K", experiments, samples, 0)
+        m.component<Matrix<ObservedPoisson>>("K", experiments, samples, 0)
             .connect<MatrixLinesToValueArray>("a", "lambda")
             .connect<SetMatrix<int>>("x", data);
     }
@@ -58,7 +58,7 @@ void compute(int, char**) {
     MCMC mcmc(m, "model");
     mcmc.move("alpha", scale);
     mcmc.move("mu", scale);
-    mcmc.move("lambda", scale);
+    mcmc.move("lambda", gibbs);
     mcmc.suffstat("lambda", {"alpha", "mu"}, gamma_ss);
     mcmc.declare_moves();
 
@@ -31,23 +31,22 @@ license and that you accept its terms.*/
 #include "partition.hpp"
 
 IndexSet gen_indexset(std::string prefix, int amount) {
-    IndexSet result;
-    for (int i = 0; i < amount; i++) { result.insert(prefix + std::to_string(i)); }
-    return result;
+    std::vector<std::string> names;
+    for (int i = 0; i < amount; i++) { names.push_back(prefix + std::to_string(i)); }
+    return make_index_set(names);
 }
 
-std::map<std::string, std::map<std::string, int>> gen_data(const IndexSet& s1, const IndexSet& s2) {
-    std::map<std::string, std::map<std::string, int>> result;
+IndexedMatrix<int> gen_data(const IndexSet& s1, const IndexSet& s2) {
+    IndexedMatrix<int> result(s1.dictionary(), s2.dictionary());
     int i = 0;
     for (auto e_i : s1) {
         i++;
         int baseline_i = 10 + (i % 5);
         int j = 0;
-        result[e_i] = {};
         for (auto e_j : s2) {
             j++;
             int value = baseline_i + (j % 5);
-            result.at(e_i)[e_j] = value;
+            result(e_i, e_j) = value;
         }
     }
     return result;
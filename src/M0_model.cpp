@@ -28,7 +28,7 @@ license and that you accept its terms.*/
 
 struct M0 : public Composite {
     static void contents(
-        Model& m, IndexSet& experiments, IndexSet& samples, map<string, map<string, int>>& data) {
+        Model& m, IndexSet& experiments, IndexSet& samples, IndexedMatrix<int>& data) {
         m.component<OrphanExp>("alpha", 1, 1);
         m.component<OrphanExp>("mu", 1, 1);
 
@@ -36,7 +36,7 @@ struct M0 : public Composite {
             .connect<ArrayToValue>("a", "alpha")
             .connect<ArrayToValue>("b", "mu");
 
-        m.component<Matrix<Poisson>>("K", experiments, samples, 0)
+        m.component<Matrix<ObservedPoisson>>("K", experiments, samples, 0)
             .connect<MatrixLinesToValueArray>("a", "lambda")
             .connect<SetMatrix<int>>("x", data);
     }
@@ -33,7 +33,7 @@ using namespace compoGM;
 
 struct M0 : public Composite {
     static void contents(
-        Model& m, IndexSet& experiments, IndexSet& samples, map<string, map<string, int>>& data) {
+        Model& m, IndexSet& experiments, IndexSet& samples, IndexedMatrix<int>& data) {
         m.component<OrphanExp>("alpha", 1, 10);
         m.component<OrphanExp>("mu", 1, 1);
 
@@ -42,7 +42,7 @@ struct M0 : public Composite {
             .connect<ArrayToValue>("b", "mu");
 
         if (p.rank != 0) {  // slave only
-            m.component<Matrix<Poisson>>("K", experiments, samples, 0)
+            m.component<Matrix<ObservedPoisson>>("K", experiments, samples, 0)
                 .connect<MatrixLinesToValueArray>("a", "lambda")
                 .connect<SetMatrix<int>>("x", data);
         }
@@ -69,7 +69,7 @@ void compute(int, char**) {
     MpiMCMC mcmc(m, "model");
     mcmc.master_add("alpha", scale);
     mcmc.master_add("mu", scale);
-    mcmc.slave_add("lambda", scale);
+    mcmc.slave_add("lambda", gibbs);
     mcmc.declare_moves();
 
     mcmc.go(100, 10, 100);
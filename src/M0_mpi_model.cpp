@@ -1,7 +1,7 @@
 
 struct M0 : public Composite {
     static void contents(
-        Model& m, IndexSet& experiments, IndexSet& samples, map<string, map<string, int>>& data) {
+        Model& m, IndexSet& experiments, IndexSet& samples, IndexedMatrix<int>& data) {
         m.component<OrphanExp>("alpha", 1, 10);
         m.component<OrphanExp>("mu", 1, 1);
 
@@ -10,7 +10,7 @@ struct M0 : public Composite {
             .connect<ArrayToValue>("b", "mu");
 
         if (p.rank != 0) {  // slave only
-            m.component<Matrix<Poisson>>("K", experiments, samples, 0)
+            m.component<Matrix<ObservedPoisson>>("K", experiments, samples, 0)
                 .connect<MatrixLinesToValueArray>("a", "lambda")
                 .connect<SetMatrix<int>>("x", data);
         }
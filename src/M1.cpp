@@ -32,11 +32,11 @@ using namespace compoGM;
 
 struct M1 : public Composite {
     static void contents(Model& m, IndexSet& genes, IndexSet& conditions, IndexSet& samples,
-        map<string, map<string, int>>& counts, map<string, string>& condition_mapping) {
+        IndexedMatrix<int>& counts, IndexMapping& condition_mapping) {
         m.component<Matrix<OrphanNormal>>("log10(lambda)", genes, conditions, 1, 3, pow(1.5, 2));
         m.connect<MapPower10>("log10(lambda)", "lambda");
 
-        m.component<Matrix<Poisson>>("K", genes, samples, 0)
+        m.component<Matrix<ObservedPoisson>>("K", genes, samples, 0)
             .connect<SetMatrix<int>>("x", counts)
             .connect<ManyToMany<ArraysMap<UseValue>>>("a", "lambda", condition_mapping);
     }
@@ -57,15 +57,12 @@ void compute(int argc, char** argv) {
     check_consistency(counts, samples);
 
     // graphical model
-    m.component<M1>("model", counts.genes, samples.conditions, make_index_set(counts.samples),
-        counts.counts, samples.condition_mapping);
+    m.component<M1>("model", counts.genes, samples.conditions, counts.samples, counts.counts,
+        samples.condition_mapping);
 
     MCMC mcmc(m, "model");
     mcmc.move("log10(lambda)", scale);
-    // TODO support array of suffstats and/or addresses for targets (instead of just strings)!
-    // for (auto gene : counts.genes) {
-    //     mcmc.suffstat("K__" + gene, {"log10(lambda)__" + gene}, poisson);
-    // }
+    mcmc.suffstat("K", {"log10(lambda)"}, poisson);  // one suffstat per gene and condition
     mcmc.declare_moves();
 
     mcmc.go(5000, 10);
@@ -32,28 +32,27 @@ using namespace compoGM;
 
 struct M2 : public Composite {
     static void contents(Model& m, IndexSet& genes, IndexSet& conditions, IndexSet& samples,
-        map<string, map<string, int>>& counts, IndexMapping& condition_mapping,
-        map<string, double>& size_factors) {
+        IndexedMatrix<int>& counts, IndexMapping& condition_mapping,
+        IndexedArray<double>& size_factors) {
         m.component<Matrix<OrphanNormal>>("log10(q)", genes, conditions, 1, 3, 1.5);
         m.connect<MapPower10>("log10(q)", "q");
 
         m.component<Array<OrphanNormal>>("log10(alpha)", genes, 1, -2, 2);
         m.connect<MapInversePower10>("log10(alpha)", "1/alpha");
 
-        m.component<Matrix<GammaSR>>("tau", genes, samples, 1)
+        m.component<DenseMatrix<DenseGammaSR>>("tau", genes, samples, 1)
             .connect<MatrixLinesToValueArray>("a", "1/alpha")
             .connect<MatrixLinesToValueArray>("b", "1/alpha");
 
         m.component<Array<Constant<double>>>("sf", samples, 0)
             .connect<SetArray<double>>("x", size_factors);
 
-        m.component<Matrix<DeterministicTernaryNode<double>>>(
-             "lambda", genes, samples, [](double a, double b, double c) { return a * b * c; })
+        m.component<Matrix<Product>>("lambda", genes, samples)
             .connect<MatrixColumnsToValueArray>("a", "sf")
             .connect<ManyToMany<ArraysMap<UseValue>>>("b", "q", condition_mapping)
             .connect<MatrixToValueMatrix>("c", "tau");
 
-        m.component<Matrix<Poisson>>("K", genes, samples, 0)
+        m.component<DenseMatrix<DenseObservedPoisson>>("K", genes, samples, 0)
             .connect<SetMatrix<int>>("x", counts)
             .connect<MatrixToValueMatrix>("a", "lambda");
     }
@@ -74,12 +73,12 @@ void compute(int argc, char** argv) {
     check_consistency(counts, samples, size_factors);
 
     // graphical model
-    m.component<M2>("model", counts.genes, samples.conditions, make_index_set(counts.samples),
-        counts.counts, samples.condition_mapping, size_factors.size_factors);
+    m.component<M2>("model", counts.genes, samples.conditions, counts.samples, counts.counts,
+        samples.condition_mapping, size_factors.size_factors);
 
     // suffstats and metropolis hastings moves
     MCMC mcmc(m, "model");
-    mcmc.move("tau", scale);
+    mcmc.move("tau", gibbs);
     mcmc.move("log10(alpha)", shift);
     mcmc.move("log10(q)", shift);
     mcmc.declare_moves();
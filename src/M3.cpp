@@ -30,10 +30,12 @@ license and that you accept its terms.*/
 using namespace std;
 using namespace compoGM;
 
+// tau and K are dense matrices (see dense_arrays.hpp), or regular matrices of nodes like in
+// M3_static so that both can be timed with the same storage
 struct M3 : public Composite {
     static void contents(Model& m, IndexSet& genes, IndexSet& conditions, IndexSet& samples,
-        map<string, map<string, int>>& counts, IndexMapping& condition_mapping,
-        map<string, double>& size_factors) {
+        IndexedMatrix<int>& counts, IndexMapping& condition_mapping,
+        IndexedArray<double>& size_factors, bool dense = true) {
         // global variables
         m.component<OrphanNormal>("a0", 1, -2, 2);
         m.component<OrphanNormal>("a1", 1, 0, 2);
@@ -55,28 +57,36 @@ struct M3 : public Composite {
             .connect<ArrayToValue>("b", "sigma_alpha");
         m.connect<MapInversePower10>("log10(alpha)", "1/alpha");
 
-        m.component<Matrix<GammaSR>>("tau", genes, samples, 1)
-            .connect<MatrixLinesToValueArray>("a", "1/alpha")
-            .connect<MatrixLinesToValueArray>("b", "1/alpha");
+        if (dense) {
+            m.component<DenseMatrix<DenseGammaSR>>("tau", genes, samples, 1);
+        } else {
+            m.component<Matrix<GammaSR>>("tau", genes, samples, 1);
+        }
+        m.connect<MatrixLinesToValueArray>(PortAddress("a", "tau"), "1/alpha");
+        m.connect<MatrixLinesToValueArray>(PortAddress("b", "tau"), "1/alpha");
 
         m.component<Array<Constant<double>>>("sf", samples, 0)
             .connect<SetArray<double>>("x", size_factors);
 
-        m.component<Matrix<DeterministicTernaryNode<double>>>(
-             "lambda", genes, samples, [](double a, double b, double c) { return a * b * c; })
+        m.component<Matrix<Product>>("lambda", genes, samples)
             .connect<MatrixColumnsToValueArray>("a", "sf")
             .connect<ManyToMany<ArraysMap<UseValue>>>("b", "q", condition_mapping)
             .connect<MatrixToValueMatrix>("c", "tau");
 
-        m.component<Matrix<Poisson>>("K", genes, samples, 0)
-            .connect<SetMatrix<int>>("x", counts)
-            .connect<MatrixToValueMatrix>("a", "lambda");
+        if (dense) {
+            m.component<DenseMatrix<DenseObservedPoisson>>("K", genes, samples, 0);
+        } else {
+            m.component<Matrix<Poisson>>("K", genes, samples, 0);
+        }
+        m.connect<SetMatrix<int>>(PortAddress("x", "K"), counts);
+        m.connect<MatrixToValueMatrix>(PortAddress("a", "K"), "lambda");
     }
 };
 
 void compute(int argc, char** argv) {
     if (argc < 2) {
-        cerr << "usage:\n\tM3_bin <data_location>\n";
+        cerr << "usage:\n\tM3_bin <data_location> [nb_threads] [seed] [hugepages] [regular] "
+                "[freeze]\n";
         exit(1);
     }
 
@@ -89,19 +99,28 @@ void compute(int argc, char** argv) {
     auto size_factors = parse_size_factors(data_location + "/size_factors.tsv");
     check_consistency(counts, samples, size_factors);
 
+    // options after the seed: hugepages (arena backed by huge pages), regular (regular matrices
+    // instead of dense ones, see M3), freeze (MH moves on a frozen flat program where the model
+    // allows it, see MCMC::freeze)
+    set<string> options(argv + min(argc, 4), argv + argc);
+
     // graphical model
-    m.component<M3>("model", counts.genes, samples.conditions, make_index_set(counts.samples),
-        counts.counts, samples.condition_mapping, size_factors.size_factors);
+    m.component<M3>("model", counts.genes, samples.conditions, counts.samples, counts.counts,
+        samples.condition_mapping, size_factors.size_factors, options.count("regular") == 0);
 
     // suffstats and metropolis hastings moves
     MCMC mcmc(m, "model");
+    mcmc.freeze(options.count("freeze") > 0);  // before declare_moves (see MCMC::freeze)
     mcmc.move("a0", shift);
     mcmc.move("a1", shift);
     mcmc.move("sigma_alpha", scale);
     mcmc.move("log10(q)", shift);
-    mcmc.move("tau", scale);
+    mcmc.move("tau", gibbs);
     mcmc.move("log10(alpha)", shift);
     mcmc.declare_moves();
+    if (argc > 2) { mcmc.threads(atoi(argv[2])); }
+    if (argc > 3) { mcmc.seed(strtoull(argv[3], nullptr, 10)); }
+    mcmc.arena(true, options.count("hugepages") > 0);
 
     mcmc.go(22000, 1, {"model__log10(q)", "model__sigma_alpha", "model__log10(alpha)"});
 }
@@ -32,8 +32,8 @@ using namespace compoGM;
 
 struct M3 : public Composite {
     static void contents(Model& m, IndexSet& genes, IndexSet& conditions, IndexSet& samples,
-        map<string, map<string, int>>& counts, IndexMapping& condition_mapping,
-        map<string, double>& size_factors) {
+        IndexedMatrix<int>& counts, IndexMapping& condition_mapping,
+        IndexedArray<double>& size_factors, bool master_ghosts) {
         // global variables
         m.component<OrphanNormal>("a0", 1, -2, 2);
         m.component<OrphanNormal>("a1", 1, 0, 2);
@@ -45,43 +45,48 @@ struct M3 : public Composite {
             m.connect<MapPower10>("log10(q)", "q");
         }
 
-        // has to be on master because l10(alpha) depends on l10(alpha_bar) which depends on q_bar
-        // no need to get q/log10(q) because q_bar won't change with moves on a0/a1/sigma_alpha
-        m.component<Array<Mean>>("q_bar", genes);
-        if (p.rank) { m.connect<ArrayToValueMatrixLines>(PortAddress("parent", "q_bar"), "q"); }
-        m.component<Array<DeterministicTernaryNode<double>>>("log10(alpha_bar)", genes,
-             [](double a0, double a1, double q_bar) { return log10(a0 + a1 / q_bar); })
-            .connect<ArrayToValue>("a", "a0")
-            .connect<ArrayToValue>("b", "a1")
-            .connect<ArrayToValueArray>("c", "q_bar");
-        if (!p.rank) {
-            for (auto g : genes) {
-                m.connect<tc::Set<bool>>(PortAddress("proxy_mode", "q_bar", g), true);
+        // master needs a ghost of the blanket of a0/a1/sigma_alpha only if it scores their moves by
+        // itself (see the distributed option)
+        if (p.rank or master_ghosts) {
+            // has to be on master because l10(alpha) depends on l10(alpha_bar) which depends on
+            // q_bar; no need to get q/log10(q) because q_bar won't change with moves on
+            // a0/a1/sigma_alpha
+            m.component<Array<Mean>>("q_bar", genes);
+            if (p.rank) { m.connect<ArrayToValueMatrixLines>(PortAddress("parent", "q_bar"), "q"); }
+            m.component<Array<DeterministicTernaryNode<double>>>("log10(alpha_bar)", genes,
+                 [](double a0, double a1, double q_bar) { return log10(a0 + a1 / q_bar); })
+                .connect<ArrayToValue>("a", "a0")
+                .connect<ArrayToValue>("b", "a1")
+                .connect<ArrayToValueArray>("c", "q_bar");
+            if (!p.rank) {
+                for (auto g : genes) {
+                    m.connect<tc::Set<bool>>(
+                        PortAddress("proxy_mode", "q_bar", genes.name(g)), true);
+                }
             }
-        }
 
-        // has to be on master's ghost because it is in the blanket of a0/a1/sigma_alpha
-        m.component<Array<Normal>>("log10(alpha)", genes, 1)
-            .connect<ArrayToValueArray>("a", "log10(alpha_bar)")
-            .connect<ArrayToValue>("b", "sigma_alpha");
+            // has to be on master's ghost because it is in the blanket of a0/a1/sigma_alpha
+            m.component<Array<Normal>>("log10(alpha)", genes, 1)
+                .connect<ArrayToValueArray>("a", "log10(alpha_bar)")
+                .connect<ArrayToValue>("b", "sigma_alpha");
+        }
 
         if (p.rank) {  // slave-only variables
             m.connect<MapInversePower10>("log10(alpha)", "1/alpha");
 
-            m.component<Matrix<GammaSR>>("tau", genes, samples, 1)
+            m.component<DenseMatrix<DenseGammaSR>>("tau", genes, samples, 1)
                 .connect<MatrixLinesToValueArray>("a", "1/alpha")
                 .connect<MatrixLinesToValueArray>("b", "1/alpha");
 
             m.component<Array<Constant<double>>>("sf", samples, 0)
                 .connect<SetArray<double>>("x", size_factors);
 
-            m.component<Matrix<DeterministicTernaryNode<double>>>(
-                 "lambda", genes, samples, [](double a, double b, double c) { return a * b * c; })
+            m.component<Matrix<Product>>("lambda", genes, samples)
                 .connect<MatrixColumnsToValueArray>("a", "sf")
                 .connect<ManyToMany<ArraysMap<UseValue>>>("b", "q", condition_mapping)
                 .connect<MatrixToValueMatrix>("c", "tau");
 
-            m.component<Matrix<Poisson>>("K", genes, samples, 0)
+            m.component<DenseMatrix<DenseObservedPoisson>>("K", genes, samples, 0)
                 .connect<SetMatrix<int>>("x", counts)
                 .connect<MatrixToValueMatrix>("a", "lambda");
         }
@@ -90,7 +95,8 @@ struct M3 : public Composite {
 
 void compute(int argc, char** argv) {
     if (argc < 2) {
-        cerr << "usage:\n\tM3_bin <data_location>\n";
+        cerr << "usage:\n\tM3_bin <data_location> [calibrate] [migrate] [async] "
+                "[distributed] [aggregate[=<group_size>]] [<gene_costs.tsv>]\n";
         exit(1);
     }
 
@@ -103,50 +109,90 @@ void compute(int argc, char** argv) {
     auto size_factors = parse_size_factors(data_location + "/size_factors.tsv");
     check_consistency(counts, samples, size_factors);
 
+    // options: calibrate (measure and write gene costs), migrate (rebalance genes between slaves
+    // during the run), async (overlap communications with moves on tau), distributed (moves on
+    // global parameters scored by all processes, without gathering genes on master), aggregate
+    // (workers communicate with master through one aggregator per node, or per group of
+    // group_size workers) and a gene cost file written by a calibration run (to balance the
+    // partition)
+    bool calibrate = false, migrate = false, async = false, distributed = false;
+    int group_size = -1;  // no aggregation
+    string cost_file;
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (option == "calibrate") {
+            calibrate = true;
+        } else if (option == "migrate") {
+            migrate = true;
+        } else if (option == "async") {
+            async = true;
+        } else if (option == "distributed") {
+            distributed = true;
+        } else if (option.substr(0, 9) == "aggregate") {
+            group_size = option.size() > 10 ? stoi(option.substr(10)) : 0;
+        } else {
+            cost_file = option;
+        }
+    }
+
+    if (group_size >= 0) { mpi_topology.setup(group_size); }
+
     // partitioning genes for slaves
     IndexSet genes;
     bool weak = true;
     if (weak) {
-        int nb_genes_total = (p.size - 1) * 16;
-        int i = 0;
-        for (auto g : counts.genes) {
-            genes.insert(g);
-            i++;
-            if (i >= nb_genes_total) { break; }
-        }
+        size_t nb_genes_total = (p.size - 1) * 16;
+        genes = counts.genes.subset(0, std::min(nb_genes_total, counts.genes.size()));
     } else {
         genes = counts.genes;
     }
 
-    Partition gene_partition(genes, p.size - 1, 1);
-    auto my_genes = gene_partition.my_partition();
-    p.message("Got %d genes", gene_partition.my_partition_size());
-
-    // graphical model
-    m.component<M3>("model", my_genes, samples.conditions, make_index_set(counts.samples),
-        counts.counts, samples.condition_mapping, size_factors.size_factors);
-
-    // MPI components
-    m.component<Bcast>("globals_handler")
-        .connect<UseValue>("target", Address("model", "a0"))
-        .connect<UseValue>("target", Address("model", "a1"))
-        .connect<UseValue>("target", Address("model", "sigma_alpha"));
-
-    m.component<Gather>("log10(alpha)_handler", gene_partition)
-        .connect<OneToMany<UseValue>>("target", Address("model", "log10(alpha)"));
-
-    m.component<Gather>("q_bar_handler", gene_partition)
-        .connect<OneToMany<UseValue>>("target", Address("model", "q_bar"));
+    Partition gene_partition = !cost_file.empty()
+                                   ? Partition(genes, parse_costs(cost_file, genes), p.size - 1, 1)
+                                   : Partition(genes, p.size - 1, 1);
+    // when migrating, slaves also instantiate one slice worth of neighbouring genes on each side
+    if (migrate) { gene_partition.set_margin(genes.size() / (p.size - 1)); }
+    auto my_genes = gene_partition.my_window();
+    p.message("Got %d genes (partition imbalance is %f)", int(gene_partition.my_partition_size()),
+        gene_partition.imbalance());
+
+    // graphical model (when migrating, slaves move and send only the genes they own)
+    m.component<M3>("model", my_genes, samples.conditions, counts.samples,
+        counts.counts, samples.condition_mapping, size_factors.size_factors, !distributed);
+
+    // MPI components (values of global parameters are kept identical on all processes by
+    // distributed moves)
+    if (!distributed) {
+        m.component<Bcast>("globals_handler")
+            .connect<UseValue>("target", Address("model", "a0"))
+            .connect<UseValue>("target", Address("model", "a1"))
+            .connect<UseValue>("target", Address("model", "sigma_alpha"));
+
+        m.component<Gather>("log10(alpha)_handler", gene_partition)
+            .connect<OneToMany<UseValue>>("target", Address("model", "log10(alpha)"));
+
+        m.component<Gather>("q_bar_handler", gene_partition)
+            .connect<OneToMany<UseValue>>("target", Address("model", "q_bar"));
+    }
 
     // suffstats and metropolis hastings moves
     MpiMCMC mcmc(m, "model");
-    mcmc.master_add("a0", shift);
-    mcmc.master_add("a1", shift);
-    mcmc.master_add("sigma_alpha", scale);
+    if (distributed) {
+        mcmc.move<DistributedMHMove<Shift>>("a0");
+        mcmc.move<DistributedMHMove<Shift>>("a1");
+        mcmc.move<DistributedMHMove<Scale>>("sigma_alpha");
+    } else {
+        mcmc.master_add("a0", shift);
+        mcmc.master_add("a1", shift);
+        mcmc.master_add("sigma_alpha", scale);
+    }
     mcmc.slave_add("log10(q)", shift);
-    mcmc.slave_add("tau", scale);
+    mcmc.slave_add("tau", gibbs);
     mcmc.slave_add("log10(alpha)", shift);
     mcmc.declare_moves();
+    if (calibrate) { mcmc.measure_costs(gene_partition, "gene_costs.tsv"); }
+    if (migrate) { mcmc.migrate(gene_partition, 50); }
+    mcmc.async(async);
 
     mcmc.go(1000, 10, 100);
 }
@@ -1,8 +1,8 @@
 
 struct M3 : public Composite {
     static void contents(Model& m, IndexSet& genes, IndexSet& conditions, IndexSet& samples,
-        map<string, map<string, int>>& counts, IndexMapping& condition_mapping,
-        map<string, double>& size_factors) {
+        IndexedMatrix<int>& counts, IndexMapping& condition_mapping,
+        IndexedArray<double>& size_factors) {
         // global variables
         m.component<OrphanNormal>("a0", 1, -2, 2);
         m.component<OrphanNormal>("a1", 1, 0, 2);
@@ -25,7 +25,7 @@ struct M3 : public Composite {
             .connect<ArrayToValueArray>("c", "q_bar");
         if (!p.rank) {
             for (auto g : genes) {
-                m.connect<tc::Set<bool>>(PortAddress("proxy_mode", "q_bar", g), true);
+                m.connect<tc::Set<bool>>(PortAddress("proxy_mode", "q_bar", genes.name(g)), true);
             }
         }
 
@@ -37,20 +37,19 @@ struct M3 : public Composite {
         if (p.rank) {  // slave-only variables
             m.connect<MapInversePower10>("log10(alpha)", "1/alpha");
 
-            m.component<Matrix<GammaSR>>("tau", genes, samples, 1)
+            m.component<DenseMatrix<DenseGammaSR>>("tau", genes, samples, 1)
                 .connect<MatrixLinesToValueArray>("a", "1/alpha")
                 .connect<MatrixLinesToValueArray>("b", "1/alpha");
 
             m.component<Array<Constant<double>>>("sf", samples, 0)
                 .connect<SetArray<double>>("x", size_factors);
 
-            m.component<Matrix<DeterministicTernaryNode<double>>>(
-                 "lambda", genes, samples, [](double a, double b, double c) { return a * b * c; })
+            m.component<Matrix<Product>>("lambda", genes, samples)
                 .connect<MatrixColumnsToValueArray>("a", "sf")
                 .connect<ManyToMany<ArraysMap<UseValue>>>("b", "q", condition_mapping)
                 .connect<MatrixToValueMatrix>("c", "tau");
 
-            m.component<Matrix<Poisson>>("K", genes, samples, 0)
+            m.component<DenseMatrix<DenseObservedPoisson>>("K", genes, samples, 0)
                 .connect<SetMatrix<int>>("x", counts)
                 .connect<MatrixToValueMatrix>("a", "lambda");
         }
@@ -0,0 +1,317 @@
+/*Copyright or © or Copr. Centre National de la Recherche Scientifique (CNRS) (2018).
+Contributors:
+* Vincent LANORE - vincent.lanore@univ-lyon1.fr
+
+This software is a component-based library to write bayesian inference programs based on the
+graphical model.
+
+This software is governed by the CeCILL-C license under French law and abiding by the rules of
+distribution of free software. You can use, modify and/ or redistribute the software under the terms
+of the CeCILL-C license as circulated by CEA, CNRS and INRIA at the following URL
+"http:////www.cecill.info".
+
+As a counterpart to the access to the source code and rights to copy, modify and redistribute
+granted by the license, users are provided only with a limited warranty and the software's author,
+the holder of the economic rights, and the successive licensors have only limited liability.
+
+In this respect, the user's attention is drawn to the risks associated with loading, using,
+modifying and/or developing or reproducing the software by the user in light of its specific status
+of free software, that may mean that it is complicated to manipulate, and that also therefore means
+that it is reserved for developers and experienced professionals having in-depth computer knowledge.
+Users are therefore encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or data to be ensured and,
+more generally, to use and operate it in the same conditions as regards security.
+
+The fact that you are presently reading this means that you have had knowledge of the CeCILL-C
+license and that you accept its terms.*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <tinycompo.hpp>
+#include "computing_entity.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+====================================================================================================
+  ~*~ Arena ~*~
+  Bump allocator for the components of an assembly (see ArenaAllocated). Memory is obtained in large
+  chunks, optionally backed by transparent huge pages, and is released all at once when the arena
+  is destroyed (the arena must outlive the assembly). An arena can follow a placement plan giving
+  the offset of each allocation (by allocation number) in one contiguous region, e.g., to place
+  components of a same gene next to each other (see arena_assembly).
+==================================================================================================*/
+class Arena {
+    struct Chunk {
+        char* data;
+        size_t size;
+        bool mapped;  // obtained with mmap (else malloc)
+    };
+    std::vector<Chunk> chunks;
+    char* current{nullptr};  // chunk used for bump allocation
+    size_t current_size{0}, used{0};
+    size_t chunk_size;
+    bool huge_pages;
+    bool huge_pages_ok{true};  // all madvise calls succeeded
+
+    // placement plan: allocation i of size plan_sizes[i] goes to planned + plan_offsets[i]
+    std::vector<size_t> plan_sizes, plan_offsets;
+    char* planned{nullptr};
+    size_t nb_planned{0}, nb_unplanned{0};
+
+    // allocations in order (pointer, size), used to build placement plans
+    std::vector<std::pair<char*, size_t>> allocations;
+    size_t bytes_allocated{0};
+
+    static constexpr size_t alignment = 16;
+    static constexpr size_t huge_page_size = size_t(2) << 20;
+
+    static size_t round_up(size_t size, size_t to) { return (size + to - 1) / to * to; }
+
+    char* new_chunk(size_t size) {
+#ifdef __linux__
+        if (huge_pages) {
+            size_t mapped_size = round_up(size, huge_page_size) + huge_page_size;  // to align
+            void* ptr = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr != MAP_FAILED) {
+                chunks.push_back({static_cast<char*>(ptr), mapped_size, true});
+                char* aligned = reinterpret_cast<char*>(
+                    round_up(reinterpret_cast<size_t>(ptr), huge_page_size));
+                if (madvise(aligned, round_up(size, huge_page_size), MADV_HUGEPAGE) != 0) {
+                    huge_pages_ok = false;
+                }
+                return aligned;
+            }
+            huge_pages_ok = false;
+        }
+#endif
+        char* data = static_cast<char*>(malloc(size));
+        if (data == nullptr) { compoGM::p.fail("Arena: could not allocate memory"); }
+        chunks.push_back({data, size, false});
+        return data;
+    }
+
+    char* bump(size_t size) {
+        if (current == nullptr or used + size > current_size) {
+            current_size = std::max(size, chunk_size);
+            current = new_chunk(current_size);
+            used = 0;
+        }
+        char* result = current + used;
+        used += size;
+        return result;
+    }
+
+  public:
+    Arena(bool huge_pages = false, size_t chunk_size = size_t(64) << 20)
+        : chunk_size(chunk_size), huge_pages(huge_pages) {}
+
+    Arena(const Arena&) = delete;
+
+    ~Arena() {
+        for (auto& chunk : chunks) {
+#ifdef __linux__
+            if (chunk.mapped) {
+                munmap(chunk.data, chunk.size);
+                continue;
+            }
+#endif
+            free(chunk.data);
+        }
+    }
+
+    // size must be a multiple of the alignment (see ArenaAllocated)
+    void* allocate(size_t size) {
+        size_t number = allocations.size();
+        char* result;
+        if (number < plan_sizes.size() and plan_sizes[number] == size) {
+            result = planned + plan_offsets[number];
+            nb_planned++;
+        } else {
+            result = bump(size);
+            if (!plan_sizes.empty()) { nb_unplanned++; }
+        }
+        allocations.emplace_back(result, size);
+        bytes_allocated += size;
+        return result;
+    }
+
+    // allocations are placed in the given order (a permutation of allocation numbers); must be
+    // called before anything is allocated
+    void set_plan(const std::vector<size_t>& sizes, const std::vector<size_t>& order) {
+        plan_sizes = sizes;
+        plan_offsets.assign(sizes.size(), 0);
+        size_t offset = 0;
+        for (auto i : order) {
+            plan_offsets[i] = offset;
+            offset += sizes[i];
+        }
+        planned = bump(std::max(offset, alignment));
+    }
+
+    const std::vector<std::pair<char*, size_t>>& get_allocations() const { return allocations; }
+
+    void report() const {
+        size_t reserved = 0;
+        for (auto& chunk : chunks) { reserved += chunk.size; }
+        compoGM::p.message("Arena: %d objects, %.2f MB allocated in %.2f MB reserved (%d chunks%s)",
+            int(allocations.size()), bytes_allocated / 1e6, reserved / 1e6, int(chunks.size()),
+            !huge_pages ? "" : huge_pages_ok ? ", huge pages" : ", huge pages unavailable");
+        if (!plan_sizes.empty()) {
+            compoGM::p.message("Arena: %d objects placed according to plan, %d unplanned",
+                int(nb_planned), int(nb_unplanned));
+        }
+    }
+};
+
+thread_local Arena* current_arena{nullptr};
+
+// components allocated while a scope is alive go to its arena
+class ArenaScope {
+    Arena* previous;
+
+  public:
+    ArenaScope(Arena* arena) : previous(current_arena) { current_arena = arena; }
+    ~ArenaScope() { current_arena = previous; }
+};
+
+/*
+====================================================================================================
+  ~*~ ArenaAllocated ~*~
+  Mixin for components: instances are allocated in the current arena if any (see ArenaScope), and on
+  the heap otherwise. A small header in front of each instance remembers where it comes from.
+==================================================================================================*/
+struct ArenaAllocated {
+    static constexpr size_t header_size = 16;  // keeps instances 16-byte aligned
+
+    static void* operator new(size_t size) {
+        size_t total = (header_size + size + 15) / 16 * 16;
+        char* block = (current_arena != nullptr)
+                          ? static_cast<char*>(current_arena->allocate(total))
+                          : static_cast<char*>(malloc(total));
+        if (block == nullptr) { throw std::bad_alloc(); }
+        *reinterpret_cast<Arena**>(block) = current_arena;
+        return block + header_size;
+    }
+
+    static void operator delete(void* ptr) {
+        if (ptr == nullptr) { return; }
+        char* block = static_cast<char*>(ptr) - header_size;
+        if (*reinterpret_cast<Arena**>(block) == nullptr) { free(block); }  // else freed with arena
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ arena_assembly ~*~
+  Instantiates an assembly in an arena. When a placement key is given, the model is first
+  instantiated in a scratch arena to find which allocation corresponds to which component
+  (instantiation order is deterministic), and allocations of the actual assembly are then placed by
+  key (e.g., all components of a same gene, whatever their array, end up next to each other).
+==================================================================================================*/
+std::unique_ptr<tc::Assembly> arena_assembly(const tc::Model& model, Arena& arena,
+    std::function<std::string(const tc::Address&)> placement_key = nullptr) {
+    if (placement_key) {
+        Arena scratch;
+        std::vector<std::string> keys;
+        {
+            ArenaScope scope(&scratch);
+            tc::Assembly scratch_assembly(model);
+            auto& allocations = scratch.get_allocations();
+            keys.assign(allocations.size(), "");
+            std::vector<std::pair<char*, size_t>> by_address;  // (start, allocation number)
+            for (size_t i = 0; i < allocations.size(); i++) {
+                by_address.emplace_back(allocations[i].first, i);
+            }
+            std::sort(by_address.begin(), by_address.end());
+
+            // components point inside their allocation (Component is not always the first base)
+            auto components = scratch_assembly.get_all<tc::Component>();
+            auto names = components.names();
+            auto pointers = components.pointers();
+            for (size_t i = 0; i < pointers.size(); i++) {
+                auto ptr = reinterpret_cast<char*>(pointers[i]);
+                auto it = std::upper_bound(by_address.begin(), by_address.end(),
+                    std::make_pair(ptr, ~size_t(0)));
+                if (it == by_address.begin()) { continue; }  // not allocated in the arena
+                auto number = std::prev(it)->second;
+                if (ptr < allocations[number].first + allocations[number].second) {
+                    keys[number] = placement_key(names[i]);
+                }
+            }
+        }
+        std::vector<size_t> sizes, order;
+        for (auto& allocation : scratch.get_allocations()) {
+            order.push_back(sizes.size());
+            sizes.push_back(allocation.second);
+        }
+        std::stable_sort(order.begin(), order.end(),
+            [&keys](size_t i, size_t j) { return keys[i] < keys[j]; });
+        arena.set_plan(sizes, order);
+    }
+    ArenaScope scope(&arena);
+    return std::unique_ptr<tc::Assembly>(new tc::Assembly(model));
+}
+
+/*
+====================================================================================================
+  ~*~ TLBMissCounter ~*~
+  Counts data TLB misses of the calling thread (and threads it creates afterwards) with perf events.
+  Not available on all systems (see available()), in which case counts are always zero.
+==================================================================================================*/
+class TLBMissCounter {
+    int fd{-1};
+
+  public:
+    TLBMissCounter() {
+#ifdef __linux__
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    TLBMissCounter(const TLBMissCounter&) = delete;
+
+    ~TLBMissCounter() {
+#ifdef __linux__
+        if (fd >= 0) { close(fd); }
+#endif
+    }
+
+    bool available() const { return fd >= 0; }
+
+    long long count() const {
+        long long result = 0;
+#ifdef __linux__
+        if (fd >= 0 and read(fd, &result, sizeof(result)) != sizeof(result)) { result = 0; }
+#endif
+        return result;
+    }
+};
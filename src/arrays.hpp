@@ -37,8 +37,8 @@ license and that you accept its terms.*/
 template <class Element>
 struct Array : public tc::Composite {
     template <class... Args>
-    static void contents(tc::Model& m, IndexSet indices, Args... args) {
-        for (auto&& index : indices) { m.component<Element>(index, args...); }
+    static void contents(tc::Model& m, const IndexSet& indices, Args... args) {
+        for (auto index : indices) { m.component<Element>(indices.name(index), args...); }
     }
 };
 
@@ -81,17 +81,8 @@ using ManyToMany2D = ManyToMany<ManyToMany<P2PConnector>>;
 ==================================================================================================*/
 template <class ValueType, class Setter = tc::Set<ValueType>>
 struct SetArray : tc::Meta {
-    static void connect(
-        tc::Model& m, tc::PortAddress array, std::map<std::string, ValueType> data) {
+    static void connect(tc::Model& m, tc::PortAddress array, const IndexedArray<ValueType>& data) {
         auto array_elements = m.get_composite(array.address).all_component_names(0, true);
-        IndexSet data_keys;
-        for (auto&& entry : data) { data_keys.insert(entry.first); }
-        // bool element_names_match =
-        //     IndexSet(array_elements.begin(), array_elements.end()) == data_keys;
-        // if (!element_names_match) {
-        //     throw tc::TinycompoException(
-        //         "SetArray: list of keys of data and elements don't match.");
-        // }
         for (auto&& element : array_elements) {
             m.connect<Setter>(
                 tc::PortAddress(array.prop, array.address, element), data.at(element));
@@ -99,8 +90,20 @@ struct SetArray : tc::Meta {
     }
 };
 
-template <class ValueType>
-using SetMatrix = SetArray<std::map<std::string, ValueType>, SetArray<ValueType>>;
+template <class ValueType, class Setter = tc::Set<ValueType>>
+struct SetMatrix : tc::Meta {
+    static void connect(
+        tc::Model& m, tc::PortAddress matrix, const IndexedMatrix<ValueType>& data) {
+        auto& composite = m.get_composite(matrix.address);
+        for (auto&& row : composite.all_component_names(0, true)) {
+            Index i = data.rows().id(row);
+            for (auto&& col : composite.get_composite(row).all_component_names(0, true)) {
+                m.connect<Setter>(tc::PortAddress(matrix.prop, matrix.address, row, col),
+                    data(i, data.cols().id(col)));
+            }
+        }
+    }
+};
 
 /*
 ====================================================================================================
@@ -115,7 +118,7 @@ struct ArraysMap : tc::Meta {
         auto user_elements = m.get_composite(user.address).all_component_names(0, true);
         for (auto&& element : user_elements) {
             m.connect<P2PConnector>(tc::PortAddress(user.prop, user.address, element),
-                tc::Address(provider, mapping.at(element)), args...);
+                tc::Address(provider, mapping.target_name(element)), args...);
         }
     }
 };
@@ -128,7 +131,8 @@ struct ArraysRevMap : tc::Meta {
         Args... args) {  // mapping provider index -> user index
         auto provider_elements = m.get_composite(provider).all_component_names(0, true);
         for (auto&& element : provider_elements) {
-            m.connect<P2PConnector>(tc::PortAddress(user.prop, user.address, mapping.at(element)),
+            m.connect<P2PConnector>(
+                tc::PortAddress(user.prop, user.address, mapping.target_name(element)),
                 tc::Address(provider, element), args...);
         }
     }
@@ -0,0 +1,107 @@
+/*Copyright or © or Copr. Centre National de la Recherche Scientifique (CNRS) (2018).
+Contributors:
+* Vincent LANORE - vincent.lanore@univ-lyon1.fr
+
+This software is a component-based library to write bayesian inference programs based on the
+graphical model.
+
+This software is governed by the CeCILL-C license under French law and abiding by the rules of
+distribution of free software. You can use, modify and/ or redistribute the software under the terms
+of the CeCILL-C license as circulated by CEA, CNRS and INRIA at the following URL
+"http:////www.cecill.info".
+
+As a counterpart to the access to the source code and rights to copy, modify and redistribute
+granted by the license, users are provided only with a limited warranty and the software's author,
+the holder of the economic rights, and the successive licensors have only limited liability.
+
+In this respect, the user's attention is drawn to the risks associated with loading, using,
+modifying and/or developing or reproducing the software by the user in light of its specific status
+of free software, that may mean that it is complicated to manipulate, and that also therefore means
+that it is reserved for developers and experienced professionals having in-depth computer knowledge.
+Users are therefore encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or data to be ensured and,
+more generally, to use and operate it in the same conditions as regards security.
+
+The fact that you are presently reading this means that you have had knowledge of the CeCILL-C
+license and that you accept its terms.*/
+
+#pragma once
+
+#include <unordered_map>
+#include "gm_index.hpp"
+
+/*
+====================================================================================================
+  ~*~ Move footprint ~*~
+  Nodes read and written when performing a move on a target: the target, its blanket, the
+  deterministic nodes in between and everything upstream of them that is needed to compute their
+  log probs. Cached deterministic nodes count as written since reading them can update their cache.
+==================================================================================================*/
+struct MoveFootprint {
+    NameSet read, written;
+};
+
+MoveFootprint move_footprint(const NodeName& target, const GMIndex& index) {
+    MoveFootprint result;
+    result.read.insert(target);
+    result.written.insert(target);
+
+    // downstream: deterministic nodes depending on target and their probabilistic children
+    std::vector<NodeName> stack{target};
+    while (!stack.empty()) {
+        auto node = stack.back();
+        stack.pop_back();
+        for (auto& child : index.children_of(node)) {
+            bool new_node = result.read.insert(child.first).second;
+            if (new_node and index.det(child.first)) { stack.push_back(child.first); }
+        }
+    }
+
+    // upstream: everything needed to compute values and log probs of downstream nodes
+    stack.assign(result.read.begin(), result.read.end());
+    while (!stack.empty()) {
+        auto node = stack.back();
+        stack.pop_back();
+        for (auto parent : index.parents_of(node)) {
+            bool new_node = result.read.insert(parent).second;
+            if (new_node and index.det(parent)) { stack.push_back(parent); }
+        }
+    }
+
+    for (auto node : result.read) {
+        if (index.cached(node)) { result.written.insert(node); }
+    }
+    return result;
+}
+
+/*
+====================================================================================================
+  ~*~ Move coloring ~*~
+  Greedy coloring of moves such that two moves with the same color are independent, i.e., none of
+  them writes a node read by the other one. Moves of a same color can then be performed in parallel.
+==================================================================================================*/
+std::vector<int> color_moves(const std::vector<MoveFootprint>& footprints) {
+    std::unordered_map<NodeName, std::set<int>> reader_colors, writer_colors;
+    std::vector<int> result;
+    for (auto& footprint : footprints) {
+        std::set<int> forbidden;
+        for (auto& node : footprint.read) {
+            auto it = writer_colors.find(node);
+            if (it != writer_colors.end()) {
+                forbidden.insert(it->second.begin(), it->second.end());
+            }
+        }
+        for (auto& node : footprint.written) {
+            auto it = reader_colors.find(node);
+            if (it != reader_colors.end()) {
+                forbidden.insert(it->second.begin(), it->second.end());
+            }
+        }
+        int color = 0;
+        while (forbidden.count(color) > 0) { color++; }
+        for (auto& node : footprint.read) { reader_colors[node].insert(color); }
+        for (auto& node : footprint.written) { writer_colors[node].insert(color); }
+        result.push_back(color);
+    }
+    return result;
+}
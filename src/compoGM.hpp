@@ -28,6 +28,7 @@ license and that you accept its terms.*/
 #pragma once
 
 #include "arrays.hpp"
+#include "dense_arrays.hpp"
 #include "distributions.hpp"
 #include "gm_connectors.hpp"
 #include "interfaces.hpp"
@@ -36,6 +37,7 @@ license and that you accept its terms.*/
 #include "moves.hpp"
 #include "node_skeletons.hpp"
 #include "parsing.hpp"
+#include "static_model.hpp"
 #include "suffstats.hpp"
 #include "trace.hpp"
 
@@ -66,4 +68,22 @@ using OrphanExp = OrphanNode<ExponentialDistribution>;
 using OrphanGamma = OrphanNode<GammaDistribution>;
 using OrphanGammaSR = OrphanNode<GammaShapeRateDistribution>;
 using OrphanPoisson = OrphanNode<PoissonDistribution>;
-using OrphanNormal = OrphanNode<NormalDistribution>;
\ No newline at end of file
+using OrphanNormal = OrphanNode<NormalDistribution>;
+
+using ObservedExp = ObservedUnaryNode<ExponentialDistribution>;
+using ObservedGamma = ObservedBinaryNode<GammaDistribution>;
+using ObservedGammaSR = ObservedBinaryNode<GammaShapeRateDistribution>;
+using ObservedPoisson = ObservedUnaryNode<PoissonDistribution>;
+using ObservedNormal = ObservedBinaryNode<NormalDistribution>;
+
+using DenseExp = DenseUnaryCell<ExponentialDistribution>;
+using DenseGamma = DenseBinaryCell<GammaDistribution>;
+using DenseGammaSR = DenseBinaryCell<GammaShapeRateDistribution>;
+using DensePoisson = DenseUnaryCell<PoissonDistribution>;
+using DenseNormal = DenseBinaryCell<NormalDistribution>;
+
+using DenseObservedExp = DenseObservedUnaryCell<ExponentialDistribution>;
+using DenseObservedGamma = DenseObservedBinaryCell<GammaDistribution>;
+using DenseObservedGammaSR = DenseObservedBinaryCell<GammaShapeRateDistribution>;
+using DenseObservedPoisson = DenseObservedUnaryCell<PoissonDistribution>;
+using DenseObservedNormal = DenseObservedBinaryCell<NormalDistribution>;
\ No newline at end of file
@@ -30,4 +30,6 @@ license and that you accept its terms.*/
 #include "compoGM.hpp"
 #include "mpi_helpers.hpp"
 #include "mpi_mcmc.hpp"
-#include "mpi_proxies.hpp"
\ No newline at end of file
+#include "mpi_moves.hpp"
+#include "mpi_proxies.hpp"
+#include "mpi_topology.hpp"
\ No newline at end of file
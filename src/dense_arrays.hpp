@@ -0,0 +1,456 @@
+/*Copyright or © or Copr. Centre National de la Recherche Scientifique (CNRS) (2018).
+Contributors:
+* Vincent LANORE - vincent.lanore@univ-lyon1.fr
+
+This software is a component-based library to write bayesian inference programs based on the
+graphical model.
+
+This software is governed by the CeCILL-C license under French law and abiding by the rules of
+distribution of free software. You can use, modify and/ or redistribute the software under the terms
+of the CeCILL-C license as circulated by CEA, CNRS and INRIA at the following URL
+"http:////www.cecill.info".
+
+As a counterpart to the access to the source code and rights to copy, modify and redistribute
+granted by the license, users are provided only with a limited warranty and the software's author,
+the holder of the economic rights, and the successive licensors have only limited liability.
+
+In this respect, the user's attention is drawn to the risks associated with loading, using,
+modifying and/or developing or reproducing the software by the user in light of its specific status
+of free software, that may mean that it is complicated to manipulate, and that also therefore means
+that it is reserved for developers and experienced professionals having in-depth computer knowledge.
+Users are therefore encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or data to be ensured and,
+more generally, to use and operate it in the same conditions as regards security.
+
+The fact that you are presently reading this means that you have had knowledge of the CeCILL-C
+license and that you accept its terms.*/
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <tinycompo.hpp>
+#include "arena.hpp"
+#include "interfaces.hpp"
+#include "partition.hpp"
+
+/*
+====================================================================================================
+  ~*~ DenseStorage ~*~
+  Structure-of-arrays storage shared by all the cells of a dense array or matrix. Cells are stored
+  in the order of their indices (row-major for matrices) so that sweeps over moves of consecutive
+  elements walk memory linearly.
+==================================================================================================*/
+template <class PDS>
+struct DenseStorage {
+    using ValueType = typename PDS::ValueType;
+    std::vector<ValueType> values, bk_values;
+    std::vector<size_t> versions;
+    std::vector<Value<double>*> a, b;  // parents (b is unused for one-parameter distributions)
+    std::vector<const Versioned*> a_versions, b_versions;
+
+    DenseStorage(size_t size, ValueType init)
+        : values(size, init),
+          bk_values(size, init),
+          versions(size, 0),
+          a(size, nullptr),
+          b(size, nullptr),
+          a_versions(size, nullptr),
+          b_versions(size, nullptr) {}
+
+    size_t size() const { return values.size(); }
+};
+
+/*
+====================================================================================================
+  ~*~ DenseCell ~*~
+  View on one element of a DenseStorage. Cells expose the same interfaces (and ports) as regular
+  nodes so that the graphical model can be indexed and connected as usual, but hot loops do not go
+  through them: moves and blankets that handle many cells of a same storage work on the storage
+  directly, using the position of each cell (see DenseBlanket below, dense sibling groups in
+  suffstats.hpp and DenseGibbsMove in mcmc_moves.hpp). Log probs of a cell are static functions of
+  the storage and position, shared by the cell interfaces and by these array-level components.
+==================================================================================================*/
+template <class PDS>
+class DenseCell : public Value<typename PDS::ValueType>,
+                  public Backup,
+                  public Versioned,
+                  public tc::Component,
+                  public ArenaAllocated {
+  public:
+    using ValueType = typename PDS::ValueType;
+    using Storage = DenseStorage<PDS>;
+
+  protected:
+    std::shared_ptr<Storage> storage;
+    size_t i;
+
+    void set_value(ValueType value) { storage->values[i] = value; }
+    void set_a(Value<double>* ptr) {
+        storage->a[i] = ptr;
+        storage->a_versions[i] = dynamic_cast<const Versioned*>(ptr);
+    }
+    void set_b(Value<double>* ptr) {
+        storage->b[i] = ptr;
+        storage->b_versions[i] = dynamic_cast<const Versioned*>(ptr);
+    }
+
+  public:
+    DenseCell(std::shared_ptr<Storage> storage, size_t i) : storage(storage), i(i) {
+        port("x", &DenseCell::set_value);
+        port("a", &DenseCell::set_a);
+    }
+    ValueType& get_ref() final { return storage->values[i]; }
+    const ValueType& get_ref() const final { return storage->values[i]; }
+    void backup() final {
+        storage->bk_values[i] = storage->values[i];
+        storage->versions[i]++;
+    }
+    void restore() final {
+        storage->values[i] = storage->bk_values[i];
+        storage->versions[i]++;
+    }
+    size_t get_version() const final { return storage->versions[i]; }
+    void bump_version() final { storage->versions[i]++; }
+
+    Storage& dense_storage() const { return *storage; }
+    size_t position() const { return i; }
+};
+
+template <class PDS>
+class DenseUnaryCell : public DenseCell<PDS>, public LogProb, public VersionedLogProb {
+    using DenseCell<PDS>::storage;
+    using DenseCell<PDS>::i;
+
+  public:
+    using Storage = DenseStorage<PDS>;
+
+    static double log_prob(const Storage& s, size_t i, LogProbSelector::Direction d) {
+        auto x = s.values[i];
+        double a = s.a[i]->get_ref();
+        switch (d) {
+            case LogProbSelector::X: return PDS::partial_log_prob_x(x, a);
+            case LogProbSelector::A: return PDS::partial_log_prob_a(x, a);
+            default: return PDS::full_log_prob(x, a);
+        }
+    }
+
+    // sum of log probs over n gathered values and parameters (b is unused)
+    static double batch_log_prob(const typename PDS::ValueType* x, const double* a, const double*,
+        size_t n, LogProbSelector::Direction d) {
+        switch (d) {
+            case LogProbSelector::X: return PDS::batch_partial_log_prob_x(x, a, n);
+            case LogProbSelector::A: return PDS::batch_partial_log_prob_a(x, a, n);
+            default: return PDS::batch_full_log_prob(x, a, n);
+        }
+    }
+
+    static size_t log_prob_version(const Storage& s, size_t i) {
+        return s.versions[i] + version_of(s.a_versions[i]);
+    }
+
+    DenseUnaryCell(std::shared_ptr<Storage> storage, size_t i) : DenseCell<PDS>(storage, i) {}
+    double get_log_prob() final { return log_prob(*storage, i, LogProbSelector::Full); }
+    double get_log_prob_x() final { return log_prob(*storage, i, LogProbSelector::X); }
+    double get_log_prob_a() final { return log_prob(*storage, i, LogProbSelector::A); }
+    size_t get_log_prob_version() const final { return log_prob_version(*storage, i); }
+    std::string debug() const final {
+        return "DenseUnaryCell [" + std::to_string(storage->values[i]) + "]";
+    }
+};
+
+template <class PDS>
+class DenseBinaryCell : public DenseCell<PDS>, public LogProb, public VersionedLogProb {
+    using DenseCell<PDS>::storage;
+    using DenseCell<PDS>::i;
+
+  public:
+    using Storage = DenseStorage<PDS>;
+
+    static double log_prob(const Storage& s, size_t i, LogProbSelector::Direction d) {
+        double x = s.values[i], a = s.a[i]->get_ref(), b = s.b[i]->get_ref();
+        switch (d) {
+            case LogProbSelector::X: return PDS::partial_log_prob_x(x, a, b);
+            case LogProbSelector::A: return PDS::partial_log_prob_a(x, a, b);
+            case LogProbSelector::B: return PDS::partial_log_prob_b(x, a, b);
+            default: return PDS::full_log_prob(x, a, b);
+        }
+    }
+
+    // sum of log probs over n gathered values and parameters
+    static double batch_log_prob(const double* x, const double* a, const double* b, size_t n,
+        LogProbSelector::Direction d) {
+        switch (d) {
+            case LogProbSelector::X: return PDS::batch_partial_log_prob_x(x, a, b, n);
+            case LogProbSelector::A: return PDS::batch_partial_log_prob_a(x, a, b, n);
+            case LogProbSelector::B: return PDS::batch_partial_log_prob_b(x, a, b, n);
+            default: return PDS::batch_full_log_prob(x, a, b, n);
+        }
+    }
+
+    static size_t log_prob_version(const Storage& s, size_t i) {
+        return s.versions[i] + version_of(s.a_versions[i]) + version_of(s.b_versions[i]);
+    }
+
+    DenseBinaryCell(std::shared_ptr<Storage> storage, size_t i) : DenseCell<PDS>(storage, i) {
+        this->port("b", &DenseBinaryCell::set_b);
+    }
+    double get_log_prob() final { return log_prob(*storage, i, LogProbSelector::Full); }
+    double get_log_prob_x() final { return log_prob(*storage, i, LogProbSelector::X); }
+    double get_log_prob_a() final { return log_prob(*storage, i, LogProbSelector::A); }
+    double get_log_prob_b() final { return log_prob(*storage, i, LogProbSelector::B); }
+    size_t get_log_prob_version() const final { return log_prob_version(*storage, i); }
+    std::string debug() const final {
+        return "DenseBinaryCell [" + std::to_string(storage->values[i]) + "]";
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ Dense observed cells ~*~
+  Dense counterparts of observed nodes: values can never be moved and data-only terms are stored
+  next to the values when the value is set.
+==================================================================================================*/
+template <class PDS>
+struct DenseObservedStorage {
+    using ValueType = typename PDS::ValueType;
+    std::vector<ValueType> values;
+    std::vector<typename PDS::Data> data;
+    std::vector<size_t> versions;
+    std::vector<Value<double>*> a, b;  // parents (b is unused for one-parameter distributions)
+    std::vector<const Versioned*> a_versions, b_versions;
+
+    DenseObservedStorage(size_t size, ValueType init)
+        : values(size, init),
+          data(size, PDS::data(init)),
+          versions(size, 0),
+          a(size, nullptr),
+          b(size, nullptr),
+          a_versions(size, nullptr),
+          b_versions(size, nullptr) {}
+
+    size_t size() const { return values.size(); }
+};
+
+template <class PDS>
+class DenseObservedCell : public Value<typename PDS::ValueType>,
+                          public Versioned,
+                          public tc::Component,
+                          public ArenaAllocated {
+  public:
+    using ValueType = typename PDS::ValueType;
+    using Storage = DenseObservedStorage<PDS>;
+
+  protected:
+    std::shared_ptr<Storage> storage;
+    size_t i;
+
+    void set_value(ValueType value) {
+        storage->values[i] = value;
+        storage->data[i] = PDS::data(value);
+    }
+    void set_a(Value<double>* ptr) {
+        storage->a[i] = ptr;
+        storage->a_versions[i] = dynamic_cast<const Versioned*>(ptr);
+    }
+    void set_b(Value<double>* ptr) {
+        storage->b[i] = ptr;
+        storage->b_versions[i] = dynamic_cast<const Versioned*>(ptr);
+    }
+
+  public:
+    DenseObservedCell(std::shared_ptr<Storage> storage, size_t i) : storage(storage), i(i) {
+        port("x", &DenseObservedCell::set_value);
+        port("a", &DenseObservedCell::set_a);
+    }
+    ValueType& get_ref() final { return storage->values[i]; }
+    const ValueType& get_ref() const final { return storage->values[i]; }
+    size_t get_version() const final { return storage->versions[i]; }
+    void bump_version() final {  // value was overwritten through get_ref
+        storage->data[i] = PDS::data(storage->values[i]);
+        storage->versions[i]++;
+    }
+
+    Storage& dense_storage() const { return *storage; }
+    size_t position() const { return i; }
+};
+
+template <class PDS>
+class DenseObservedUnaryCell : public DenseObservedCell<PDS>,
+                               public LogProb,
+                               public VersionedLogProb {
+    using DenseObservedCell<PDS>::storage;
+    using DenseObservedCell<PDS>::i;
+
+  public:
+    using Storage = DenseObservedStorage<PDS>;
+
+    static double log_prob(const Storage& s, size_t i, LogProbSelector::Direction d) {
+        double a = s.a[i]->get_ref();
+        if (d == LogProbSelector::A) { return PDS::partial_log_prob_a(s.values[i], s.data[i], a); }
+        return PDS::full_log_prob(s.values[i], s.data[i], a);
+    }
+
+    // sum of log probs over n gathered values and parameters (b is unused); data-only terms are
+    // recomputed by the batch log densities instead of being gathered
+    static double batch_log_prob(const typename PDS::ValueType* x, const double* a, const double*,
+        size_t n, LogProbSelector::Direction d) {
+        if (d == LogProbSelector::A) { return PDS::batch_partial_log_prob_a(x, a, n); }
+        return PDS::batch_full_log_prob(x, a, n);
+    }
+
+    static size_t log_prob_version(const Storage& s, size_t i) {
+        return s.versions[i] + version_of(s.a_versions[i]);
+    }
+
+    DenseObservedUnaryCell(std::shared_ptr<Storage> storage, size_t i)
+        : DenseObservedCell<PDS>(storage, i) {}
+    double get_log_prob() final { return log_prob(*storage, i, LogProbSelector::Full); }
+    double get_log_prob_a() final { return log_prob(*storage, i, LogProbSelector::A); }
+    size_t get_log_prob_version() const final { return log_prob_version(*storage, i); }
+    std::string debug() const final {
+        return "DenseObservedUnaryCell [" + std::to_string(storage->values[i]) + "]";
+    }
+};
+
+template <class PDS>
+class DenseObservedBinaryCell : public DenseObservedCell<PDS>,
+                                public LogProb,
+                                public VersionedLogProb {
+    using DenseObservedCell<PDS>::storage;
+    using DenseObservedCell<PDS>::i;
+
+  public:
+    using Storage = DenseObservedStorage<PDS>;
+
+    static double log_prob(const Storage& s, size_t i, LogProbSelector::Direction d) {
+        double a = s.a[i]->get_ref(), b = s.b[i]->get_ref();
+        switch (d) {
+            case LogProbSelector::A: return PDS::partial_log_prob_a(s.values[i], s.data[i], a, b);
+            case LogProbSelector::B: return PDS::partial_log_prob_b(s.values[i], s.data[i], a, b);
+            default: return PDS::full_log_prob(s.values[i], s.data[i], a, b);
+        }
+    }
+
+    // sum of log probs over n gathered values and parameters (see DenseObservedUnaryCell)
+    static double batch_log_prob(const double* x, const double* a, const double* b, size_t n,
+        LogProbSelector::Direction d) {
+        switch (d) {
+            case LogProbSelector::A: return PDS::batch_partial_log_prob_a(x, a, b, n);
+            case LogProbSelector::B: return PDS::batch_partial_log_prob_b(x, a, b, n);
+            default: return PDS::batch_full_log_prob(x, a, b, n);
+        }
+    }
+
+    static size_t log_prob_version(const Storage& s, size_t i) {
+        return s.versions[i] + version_of(s.a_versions[i]) + version_of(s.b_versions[i]);
+    }
+
+    DenseObservedBinaryCell(std::shared_ptr<Storage> storage, size_t i)
+        : DenseObservedCell<PDS>(storage, i) {
+        this->port("b", &DenseObservedBinaryCell::set_b);
+    }
+    double get_log_prob() final { return log_prob(*storage, i, LogProbSelector::Full); }
+    double get_log_prob_a() final { return log_prob(*storage, i, LogProbSelector::A); }
+    double get_log_prob_b() final { return log_prob(*storage, i, LogProbSelector::B); }
+    size_t get_log_prob_version() const final { return log_prob_version(*storage, i); }
+    std::string debug() const final {
+        return "DenseObservedBinaryCell [" + std::to_string(storage->values[i]) + "]";
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ DenseBlanket ~*~
+  Log prob of several cells of a same dense storage (e.g., the counts a move on a gene and
+  condition reaches), computed in one call instead of one virtual call per cell: values and
+  parameters are gathered from the storage into contiguous buffers, then summed by the batch log
+  densities of the distribution (vectorized, see simd.hpp). Created by ConnectIndividualMove for
+  blanket cells that are not scored by a sibling group.
+==================================================================================================*/
+template <class Cell>
+class DenseBlanket : public LogProb,
+                     public VersionedLogProb,
+                     public tc::Component,
+                     public ArenaAllocated {
+    using Storage = typename Cell::Storage;
+    const Storage* storage{nullptr};
+    std::vector<size_t> positions;  // increasing, so that loops walk the storage linearly
+    void add_cell(Cell* cell) {
+        if (storage == nullptr) { storage = &cell->dense_storage(); }
+        if (storage != &cell->dense_storage()) {
+            compoGM::p.fail("DenseBlanket: cells do not belong to the same dense storage");
+        }
+        positions.insert(
+            std::upper_bound(positions.begin(), positions.end(), cell->position()),
+            cell->position());
+        xs.resize(positions.size());
+        as.resize(positions.size());
+        bs.resize(positions.size());
+    }
+
+    // values and parameters of the cells, gathered before each sum
+    std::vector<typename Cell::ValueType> xs;
+    std::vector<double> as, bs;
+
+    double sum(LogProbSelector::Direction d) {
+        auto& s = *storage;
+        for (size_t k = 0; k < positions.size(); k++) {
+            auto i = positions[k];
+            xs[k] = s.values[i];
+            as[k] = s.a[i]->get_ref();
+            bs[k] = (s.b[i] != nullptr) ? s.b[i]->get_ref() : 0;
+        }
+        return Cell::batch_log_prob(xs.data(), as.data(), bs.data(), positions.size(), d);
+    }
+
+  public:
+    DenseBlanket() { port("cells", &DenseBlanket::add_cell); }
+
+    double get_log_prob() final { return sum(LogProbSelector::Full); }
+    double get_log_prob_x() final { return sum(LogProbSelector::X); }
+    double get_log_prob_a() final { return sum(LogProbSelector::A); }
+    double get_log_prob_b() final { return sum(LogProbSelector::B); }
+
+    size_t get_log_prob_version() const final {
+        size_t result = 0;
+        for (auto i : positions) { result += Cell::log_prob_version(*storage, i); }
+        return result;
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ Dense array and matrix ~*~
+  Drop-in replacements for Array<Node> and Matrix<Node> where all cells share one DenseStorage.
+==================================================================================================*/
+template <class Cell>
+struct DenseArray : public tc::Composite {
+    static void contents(tc::Model& m, const IndexSet& indices, typename Cell::ValueType init) {
+        auto storage = std::make_shared<typename Cell::Storage>(indices.size(), init);
+        size_t i = 0;
+        for (auto index : indices) { m.component<Cell>(indices.name(index), storage, i++); }
+    }
+};
+
+template <class Cell>
+struct DenseRow : public tc::Composite {  // row of a dense matrix, stored at offset in storage
+    static void contents(tc::Model& m, const IndexSet& indices,
+        std::shared_ptr<typename Cell::Storage> storage, size_t offset) {
+        for (auto index : indices) { m.component<Cell>(indices.name(index), storage, offset++); }
+    }
+};
+
+template <class Cell>
+struct DenseMatrix : public tc::Composite {
+    static void contents(tc::Model& m, const IndexSet& indices_x, const IndexSet& indices_y,
+        typename Cell::ValueType init) {
+        auto storage =
+            std::make_shared<typename Cell::Storage>(indices_x.size() * indices_y.size(), init);
+        size_t offset = 0;
+        for (auto index : indices_x) {
+            m.component<DenseRow<Cell>>(indices_x.name(index), indices_y, storage, offset);
+            offset += indices_y.size();
+        }
+    }
+};
@@ -28,6 +28,7 @@ license and that you accept its terms.*/
 #pragma once
 
 #include <cmath>
+#include "simd.hpp"
 #include "utils.hpp"
 
 /*
@@ -43,6 +44,36 @@ struct ExponentialDistribution {
 
     // here a (first parameter) is lambda
     static double partial_log_prob_a(double x, double lambda) { return log(lambda) - lambda * x; }
+
+    // versions with precomputed data-only terms (used by observed nodes)
+    struct Data {};
+    static Data data(double) { return {}; }
+    static double full_log_prob(double x, const Data&, double lambda) {
+        return full_log_prob(x, lambda);
+    }
+    static double partial_log_prob_a(double x, const Data&, double lambda) {
+        return partial_log_prob_a(x, lambda);
+    }
+
+    // batch versions: sums of log probs over n values and parameters (see simd.hpp)
+    static double batch_full_log_prob(const double* x, const double* lambda, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd l = simd::load(lambda + i);
+                return simd::log(l) - l * simd::load(x + i);
+            },
+            [=](size_t i) { return full_log_prob(x[i], lambda[i]); });
+    }
+
+    static double batch_partial_log_prob_x(const double* x, const double* lambda, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd { return -simd::load(lambda + i) * simd::load(x + i); },
+            [=](size_t i) { return partial_log_prob_x(x[i], lambda[i]); });
+    }
+
+    static double batch_partial_log_prob_a(const double* x, const double* lambda, size_t n) {
+        return batch_full_log_prob(x, lambda, n);
+    }
 };
 
 /*
@@ -60,13 +91,71 @@ struct GammaShapeScaleDistribution {
         return (k - 1) * log(x) - x / theta;
     }
 
-    static double partial_log_prob_a(double, double k, double theta) {
-        return -std::lgamma(k) - k * log(theta) + (k - 1);
+    static double partial_log_prob_a(double x, double k, double theta) {
+        return -std::lgamma(k) - k * log(theta) + (k - 1) * log(x);
     }
 
     static double partial_log_prob_b(double x, double k, double theta) {
         return -k * log(theta) - x / theta;
     }
+
+    // versions with precomputed data-only terms (used by observed nodes)
+    struct Data {
+        double log_x;
+    };
+    static Data data(double x) { return {log(x)}; }
+    static double full_log_prob(double x, const Data& d, double k, double theta) {
+        return -std::lgamma(k) - k * log(theta) + (k - 1) * d.log_x - x / theta;
+    }
+    static double partial_log_prob_a(double, const Data& d, double k, double theta) {
+        return -std::lgamma(k) - k * log(theta) + (k - 1) * d.log_x;
+    }
+    static double partial_log_prob_b(double x, const Data&, double k, double theta) {
+        return partial_log_prob_b(x, k, theta);
+    }
+
+    // batch versions: sums of log probs over n values and parameters (see simd.hpp)
+    static double batch_full_log_prob(
+        const double* x, const double* k, const double* theta, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd a = simd::load(k + i), t = simd::load(theta + i);
+                simd::vd v = simd::load(x + i);
+                return -simd::lgamma(a) - a * simd::log(t) + (a - 1.0) * simd::log(v) - v / t;
+            },
+            [=](size_t i) { return full_log_prob(x[i], k[i], theta[i]); });
+    }
+
+    static double batch_partial_log_prob_x(
+        const double* x, const double* k, const double* theta, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd v = simd::load(x + i);
+                return (simd::load(k + i) - 1.0) * simd::log(v) - v / simd::load(theta + i);
+            },
+            [=](size_t i) { return partial_log_prob_x(x[i], k[i], theta[i]); });
+    }
+
+    static double batch_partial_log_prob_a(
+        const double* x, const double* k, const double* theta, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd a = simd::load(k + i);
+                return -simd::lgamma(a) - a * simd::log(simd::load(theta + i)) +
+                       (a - 1.0) * simd::log(simd::load(x + i));
+            },
+            [=](size_t i) { return partial_log_prob_a(x[i], k[i], theta[i]); });
+    }
+
+    static double batch_partial_log_prob_b(
+        const double* x, const double* k, const double* theta, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd t = simd::load(theta + i);
+                return -simd::load(k + i) * simd::log(t) - simd::load(x + i) / t;
+            },
+            [=](size_t i) { return partial_log_prob_b(x[i], k[i], theta[i]); });
+    }
 };
 
 using GammaDistribution = GammaShapeScaleDistribution;
@@ -93,6 +182,64 @@ struct GammaShapeRateDistribution {
     static double partial_log_prob_b(double x, double alpha, double beta) {
         return alpha * log(beta) - beta * x;
     }
+
+    // versions with precomputed data-only terms (used by observed nodes)
+    struct Data {
+        double log_x;
+    };
+    static Data data(double x) { return {log(x)}; }
+    static double full_log_prob(double x, const Data& d, double alpha, double beta) {
+        return alpha * log(beta) - std::lgamma(alpha) + (alpha - 1) * d.log_x - beta * x;
+    }
+    static double partial_log_prob_a(double, const Data& d, double alpha, double beta) {
+        return alpha * log(beta) - std::lgamma(alpha) + (alpha - 1) * d.log_x;
+    }
+    static double partial_log_prob_b(double x, const Data&, double alpha, double beta) {
+        return partial_log_prob_b(x, alpha, beta);
+    }
+
+    // batch versions: sums of log probs over n values and parameters (see simd.hpp)
+    static double batch_full_log_prob(
+        const double* x, const double* alpha, const double* beta, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd a = simd::load(alpha + i), b = simd::load(beta + i);
+                simd::vd v = simd::load(x + i);
+                return a * simd::log(b) - simd::lgamma(a) + (a - 1.0) * simd::log(v) - b * v;
+            },
+            [=](size_t i) { return full_log_prob(x[i], alpha[i], beta[i]); });
+    }
+
+    static double batch_partial_log_prob_x(
+        const double* x, const double* alpha, const double* beta, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd v = simd::load(x + i);
+                return (simd::load(alpha + i) - 1.0) * simd::log(v) - simd::load(beta + i) * v;
+            },
+            [=](size_t i) { return partial_log_prob_x(x[i], alpha[i], beta[i]); });
+    }
+
+    static double batch_partial_log_prob_a(
+        const double* x, const double* alpha, const double* beta, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd a = simd::load(alpha + i);
+                return a * simd::log(simd::load(beta + i)) - simd::lgamma(a) +
+                       (a - 1.0) * simd::log(simd::load(x + i));
+            },
+            [=](size_t i) { return partial_log_prob_a(x[i], alpha[i], beta[i]); });
+    }
+
+    static double batch_partial_log_prob_b(
+        const double* x, const double* alpha, const double* beta, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd b = simd::load(beta + i);
+                return simd::load(alpha + i) * simd::log(b) - b * simd::load(x + i);
+            },
+            [=](size_t i) { return partial_log_prob_b(x[i], alpha[i], beta[i]); });
+    }
 };
 
 /*
@@ -111,6 +258,46 @@ struct PoissonDistribution {
     }
 
     static double partial_log_prob_a(int x, double lambda) { return x * log(lambda) - lambda; }
+
+    // versions with precomputed data-only terms (used by observed nodes)
+    struct Data {
+        double log_factorial_x;
+    };
+    static Data data(int x) { return {log_factorial(x)}; }
+    static double full_log_prob(int x, const Data& d, double lambda) {
+        return x * log(lambda) - lambda - d.log_factorial_x;
+    }
+    static double partial_log_prob_a(int x, const Data&, double lambda) {
+        return partial_log_prob_a(x, lambda);
+    }
+
+    // batch versions: sums of log probs over n values and parameters (see simd.hpp)
+    static double batch_full_log_prob(const int* x, const double* lambda, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd v = simd::load(x + i), l = simd::load(lambda + i);
+                return v * simd::log(l) - l - simd::lgamma(v + 1.0);
+            },
+            [=](size_t i) { return full_log_prob(x[i], lambda[i]); });
+    }
+
+    static double batch_partial_log_prob_x(const int* x, const double* lambda, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd v = simd::load(x + i);
+                return v * simd::log(simd::load(lambda + i)) - simd::lgamma(v + 1.0);
+            },
+            [=](size_t i) { return partial_log_prob_x(x[i], lambda[i]); });
+    }
+
+    static double batch_partial_log_prob_a(const int* x, const double* lambda, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd l = simd::load(lambda + i);
+                return simd::load(x + i) * simd::log(l) - l;
+            },
+            [=](size_t i) { return partial_log_prob_a(x[i], lambda[i]); });
+    }
 };
 
 /*
@@ -135,4 +322,48 @@ struct NormalDistribution {
     static double partial_log_prob_b(double x, double mu, double sigma) {
         return -(x - mu) * (x - mu) / (2 * sigma * sigma) - 0.5 * log(2 * M_PI * sigma * sigma);
     }
+
+    // versions with precomputed data-only terms (used by observed nodes)
+    struct Data {};
+    static Data data(double) { return {}; }
+    static double full_log_prob(double x, const Data&, double mu, double sigma) {
+        return full_log_prob(x, mu, sigma);
+    }
+    static double partial_log_prob_a(double x, const Data&, double mu, double sigma) {
+        return partial_log_prob_a(x, mu, sigma);
+    }
+    static double partial_log_prob_b(double x, const Data&, double mu, double sigma) {
+        return partial_log_prob_b(x, mu, sigma);
+    }
+
+    // batch versions: sums of log probs over n values and parameters (see simd.hpp)
+    static double batch_full_log_prob(
+        const double* x, const double* mu, const double* sigma, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd d = simd::load(x + i) - simd::load(mu + i), s = simd::load(sigma + i);
+                return -d * d / (2.0 * s * s) - 0.5 * simd::log(2 * M_PI * s * s);
+            },
+            [=](size_t i) { return full_log_prob(x[i], mu[i], sigma[i]); });
+    }
+
+    static double batch_partial_log_prob_x(
+        const double* x, const double* mu, const double* sigma, size_t n) {
+        return simd::reduce(n,
+            [=](size_t i) -> simd::vd {
+                simd::vd d = simd::load(x + i) - simd::load(mu + i), s = simd::load(sigma + i);
+                return -d * d / (2.0 * s * s);
+            },
+            [=](size_t i) { return partial_log_prob_x(x[i], mu[i], sigma[i]); });
+    }
+
+    static double batch_partial_log_prob_a(
+        const double* x, const double* mu, const double* sigma, size_t n) {
+        return batch_partial_log_prob_x(x, mu, sigma, n);
+    }
+
+    static double batch_partial_log_prob_b(
+        const double* x, const double* mu, const double* sigma, size_t n) {
+        return batch_full_log_prob(x, mu, sigma, n);
+    }
 };
@@ -0,0 +1,472 @@
+/*Copyright or © or Copr. Centre National de la Recherche Scientifique (CNRS) (2018).
+Contributors:
+* Vincent LANORE - vincent.lanore@univ-lyon1.fr
+
+This software is a component-based library to write bayesian inference programs based on the
+graphical model.
+
+This software is governed by the CeCILL-C license under French law and abiding by the rules of
+distribution of free software. You can use, modify and/ or redistribute the software under the terms
+of the CeCILL-C license as circulated by CEA, CNRS and INRIA at the following URL
+"http:////www.cecill.info".
+
+As a counterpart to the access to the source code and rights to copy, modify and redistribute
+granted by the license, users are provided only with a limited warranty and the software's author,
+the holder of the economic rights, and the successive licensors have only limited liability.
+
+In this respect, the user's attention is drawn to the risks associated with loading, using,
+modifying and/or developing or reproducing the software by the user in light of its specific status
+of free software, that may mean that it is complicated to manipulate, and that also therefore means
+that it is reserved for developers and experienced professionals having in-depth computer knowledge.
+Users are therefore encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or data to be ensured and,
+more generally, to use and operate it in the same conditions as regards security.
+
+The fact that you are presently reading this means that you have had knowledge of the CeCILL-C
+license and that you accept its terms.*/
+
+#pragma once
+
+#include <algorithm>
+#include "distributions.hpp"
+#include "gm_connectors.hpp"
+#include "gm_index.hpp"
+#include "interfaces.hpp"
+#include "mcmc_moves.hpp"
+#include "moves.hpp"
+#include "node_skeletons.hpp"
+#include "random.hpp"
+
+/*
+====================================================================================================
+  ~*~ FrozenProgram ~*~
+  Flat version of a graphical model lowered from an assembly: nodes get integer ids in topological
+  order, their values are stored in one contiguous array and each node becomes an instruction (an
+  opcode per distribution or deterministic function along with the ids of its parameters). Moves on
+  the program (see FrozenMHMove) then run without virtual calls or version checks.
+  The assembly remains the reference: values changed by components are pulled before frozen moves
+  are performed and values changed by frozen moves are pushed back after them. Models containing
+  nodes that cannot be lowered (e.g., dense arrays or nodes with arbitrary functions of vectors) are
+  not supported, see supported().
+==================================================================================================*/
+template <class PDS>
+double unary_log_prob(LogProbSelector::Direction d, double x, double a) {
+    auto value = typename PDS::ValueType(x);
+    switch (d) {
+        case LogProbSelector::X: return PDS::partial_log_prob_x(value, a);
+        case LogProbSelector::A: return PDS::partial_log_prob_a(value, a);
+        default: return PDS::full_log_prob(value, a);
+    }
+}
+
+template <class PDS>
+double binary_log_prob(LogProbSelector::Direction d, double x, double a, double b) {
+    switch (d) {
+        case LogProbSelector::X: return PDS::partial_log_prob_x(x, a, b);
+        case LogProbSelector::A: return PDS::partial_log_prob_a(x, a, b);
+        case LogProbSelector::B: return PDS::partial_log_prob_b(x, a, b);
+        default: return PDS::full_log_prob(x, a, b);
+    }
+}
+
+class FrozenProgram {
+  public:
+    enum Opcode {
+        constant,  // value set from the assembly (or parameter of an orphan node)
+        exp_node,
+        gamma_ss_node,
+        gamma_sr_node,
+        poisson_node,
+        normal_node,
+        power10,
+        unary_function,
+        ternary_function,
+        sum,
+        mean
+    };
+
+    struct Instruction {
+        Opcode op{constant};
+        bool orphan{false};        // parameters are constants and log prob is always the one of x
+        int a{-1}, b{-1}, c{-1};   // ids of parameters
+        size_t first{0}, last{0};  // range of parameter ids in operands (sum and mean)
+        double (*f1)(double){nullptr};
+        double (*f3)(double, double, double){nullptr};
+    };
+
+    struct Term {  // log prob term of a node in a given direction
+        int node;
+        LogProbSelector::Direction direction;
+    };
+
+  private:
+    std::vector<double> values;  // value of node i is values[i]
+    std::vector<Instruction> program;
+    std::vector<int> operands;
+    std::vector<int> det_nodes;  // in topological order
+    std::map<NodeName, int> ids;
+
+    struct Binding {  // node in the assembly (no binding for deterministic nodes and parameters)
+        Value<double>* double_ref{nullptr};
+        Value<int>* int_ref{nullptr};
+        Versioned* versioned{nullptr};
+    };
+    std::vector<Binding> bindings;
+    std::vector<int> watched, published;
+
+    const GMIndex& index;
+    std::string error;
+
+    double read(int node) const {
+        auto& binding = bindings[node];
+        return (binding.double_ref != nullptr) ? binding.double_ref->get_ref()
+                                                : double(binding.int_ref->get_ref());
+    }
+
+    void write(int node) {
+        auto& binding = bindings[node];
+        if (binding.double_ref != nullptr) {
+            binding.double_ref->get_ref() = values[node];
+        } else {
+            binding.int_ref->get_ref() = int(values[node]);
+        }
+        if (binding.versioned != nullptr) { binding.versioned->bump_version(); }
+    }
+
+    int add_constant(double value) {
+        values.push_back(value);
+        program.emplace_back();
+        bindings.emplace_back();
+        return int(values.size()) - 1;
+    }
+
+    void bind(tc::Assembly& a, const tc::Model& gmref, tc::Address gm, const NodeName& name) {
+        tc::Address address(name), global(gm, address);
+        auto& binding = bindings[ids.at(name)];
+        if (has_type<Value<double>>(address, gmref)) {
+            binding.double_ref = &a.at<Value<double>>(global);
+            binding.versioned = dynamic_cast<Versioned*>(binding.double_ref);
+        } else {
+            binding.int_ref = &a.at<Value<int>>(global);
+            binding.versioned = dynamic_cast<Versioned*>(binding.int_ref);
+        }
+    }
+
+    int parent(const NodeName& name, const std::string& port) const {
+        auto& parents = index.port_parents_of(name);
+        auto it = parents.find(port);
+        return (it == parents.end()) ? -1 : ids.at(it->second);
+    }
+
+    template <class PDS>
+    bool lower_unary(tc::Assembly& a, const tc::Model& gmref, tc::Address gm,
+        const NodeName& name, Opcode op) {
+        tc::Address address(name);
+        auto id = ids.at(name);
+        if (has_type<UnaryNode<PDS>>(address, gmref) or
+            has_type<ObservedUnaryNode<PDS>>(address, gmref)) {
+            program[id].a = parent(name, "a");
+        } else if (has_type<OrphanNode<PDS>>(address, gmref)) {
+            auto& parameters = a.at<OrphanNode<PDS>>(tc::Address(gm, address)).get_parameters();
+            if (parameters.size() != 1) { return false; }
+            program[id].orphan = true;
+            int constant = add_constant(parameters[0]);  // program might be reallocated
+            program[id].a = constant;
+        } else {
+            return false;
+        }
+        program[id].op = op;
+        return program[id].a >= 0;
+    }
+
+    template <class PDS>
+    bool lower_binary(tc::Assembly& a, const tc::Model& gmref, tc::Address gm,
+        const NodeName& name, Opcode op) {
+        tc::Address address(name);
+        auto id = ids.at(name);
+        if (has_type<BinaryNode<PDS>>(address, gmref) or
+            has_type<ObservedBinaryNode<PDS>>(address, gmref)) {
+            program[id].a = parent(name, "a");
+            program[id].b = parent(name, "b");
+        } else if (has_type<OrphanNode<PDS>>(address, gmref)) {
+            auto& parameters = a.at<OrphanNode<PDS>>(tc::Address(gm, address)).get_parameters();
+            if (parameters.size() != 2) { return false; }
+            program[id].orphan = true;
+            int constant_a = add_constant(parameters[0]);  // program might be reallocated
+            int constant_b = add_constant(parameters[1]);
+            program[id].a = constant_a;
+            program[id].b = constant_b;
+        } else {
+            return false;
+        }
+        program[id].op = op;
+        return program[id].a >= 0 and program[id].b >= 0;
+    }
+
+    bool lower_det(tc::Assembly& a, const tc::Model& gmref, tc::Address gm, const NodeName& name) {
+        tc::Address address(name), global(gm, address);
+        auto& instruction = program[ids.at(name)];
+        if (has_type<Constant<double>>(address, gmref) or has_type<Constant<int>>(address, gmref)) {
+            return true;
+        } else if (has_type<Power10>(address, gmref)) {
+            instruction.op = power10;
+            instruction.a = parent(name, "a");
+        } else if (has_type<DeterministicUnaryNode<double>>(address, gmref)) {
+            instruction.op = unary_function;
+            instruction.a = parent(name, "a");
+            instruction.f1 = a.at<DeterministicUnaryNode<double>>(global).get_function();
+        } else if (has_type<DeterministicTernaryNode<double>>(address, gmref)) {
+            instruction.op = ternary_function;
+            instruction.a = parent(name, "a");
+            instruction.b = parent(name, "b");
+            instruction.c = parent(name, "c");
+            instruction.f3 = a.at<DeterministicTernaryNode<double>>(global).get_function();
+            return instruction.a >= 0 and instruction.b >= 0 and instruction.c >= 0;
+        } else if (has_type<Sum>(address, gmref) or has_type<Mean>(address, gmref)) {
+            instruction.op = has_type<Sum>(address, gmref) ? sum : mean;
+            instruction.first = operands.size();
+            for (auto& p : index.parents_of(name)) { operands.push_back(ids.at(p)); }
+            instruction.last = operands.size();
+            return instruction.last > instruction.first;
+        } else {
+            return false;
+        }
+        return instruction.a >= 0;
+    }
+
+    bool lower(tc::Assembly& a, const tc::Model& gmref, tc::Address gm, const NodeName& name) {
+        if (index.det(name)) { return lower_det(a, gmref, gm, name); }
+        return lower_unary<ExponentialDistribution>(a, gmref, gm, name, exp_node) or
+               lower_unary<PoissonDistribution>(a, gmref, gm, name, poisson_node) or
+               lower_binary<GammaShapeScaleDistribution>(a, gmref, gm, name, gamma_ss_node) or
+               lower_binary<GammaShapeRateDistribution>(a, gmref, gm, name, gamma_sr_node) or
+               lower_binary<NormalDistribution>(a, gmref, gm, name, normal_node);
+    }
+
+  public:
+    FrozenProgram(tc::Assembly& a, const tc::Model& model, tc::Address gm, const GMIndex& index)
+        : index(index) {
+        auto& gmref = model.get_composite(gm);
+
+        // topological order (parents first) by iterative depth-first search
+        std::vector<NodeName> order;
+        NameSet done;
+        for (auto& node : index.nodes()) {
+            std::vector<std::pair<NodeName, bool>> stack{{node, false}};  // (node, expanded)
+            while (!stack.empty()) {
+                auto top = stack.back();
+                stack.pop_back();
+                if (top.second) {
+                    if (done.insert(top.first).second) { order.push_back(top.first); }
+                } else if (done.count(top.first) == 0) {
+                    stack.push_back({top.first, true});
+                    for (auto& p : index.parents_of(top.first)) {
+                        if (done.count(p) == 0) { stack.push_back({p, false}); }
+                    }
+                }
+            }
+        }
+        for (size_t i = 0; i < order.size(); i++) { ids[order[i]] = int(i); }
+        values.resize(order.size());
+        program.resize(order.size());
+        bindings.resize(order.size());
+
+        for (auto& name : order) {
+            if (!lower(a, gmref, gm, name)) {
+                error = "node " + name + " cannot be lowered";
+                return;
+            }
+            if (index.det(name) and program[ids.at(name)].op != constant) {
+                det_nodes.push_back(ids.at(name));
+            } else {
+                bind(a, gmref, gm, name);
+                values[ids.at(name)] = read(ids.at(name));
+            }
+        }
+        for (auto node : det_nodes) { compute(node); }
+    }
+
+    bool supported() const { return error.empty(); }
+
+    const std::string& get_error() const { return error; }
+
+    size_t size() const { return values.size(); }
+
+    int id(const NodeName& name) const { return ids.at(name); }
+
+    double& value(int node) { return values[node]; }
+
+    double log_prob(const Term& term) const {
+        auto& i = program[term.node];
+        const double* v = values.data();
+        double x = v[term.node];
+        auto d = i.orphan ? LogProbSelector::X : term.direction;
+        switch (i.op) {
+            case exp_node: return unary_log_prob<ExponentialDistribution>(d, x, v[i.a]);
+            case poisson_node: return unary_log_prob<PoissonDistribution>(d, x, v[i.a]);
+            case gamma_ss_node:
+                return binary_log_prob<GammaShapeScaleDistribution>(d, x, v[i.a], v[i.b]);
+            case gamma_sr_node:
+                return binary_log_prob<GammaShapeRateDistribution>(d, x, v[i.a], v[i.b]);
+            case normal_node: return binary_log_prob<NormalDistribution>(d, x, v[i.a], v[i.b]);
+            default: return 0;  // deterministic nodes have no log prob
+        }
+    }
+
+    void compute(int node) {
+        auto& i = program[node];
+        double* v = values.data();
+        switch (i.op) {
+            case power10: v[node] = pow(10, v[i.a]); break;
+            case unary_function: v[node] = i.f1(v[i.a]); break;
+            case ternary_function: v[node] = i.f3(v[i.a], v[i.b], v[i.c]); break;
+            case sum:
+            case mean: {
+                double acc = 0;
+                for (size_t k = i.first; k < i.last; k++) { acc += v[operands[k]]; }
+                v[node] = (i.op == mean) ? acc / (i.last - i.first) : acc;
+                break;
+            }
+            default: break;  // nothing to compute
+        }
+    }
+
+    // log prob terms that depend on the value of name: its own (x) and the ones of its blanket
+    std::vector<Term> terms_of(const NodeName& name) const {
+        std::vector<Term> result{{ids.at(name), LogProbSelector::X}};
+        for (auto& node : index.blanket(name)) {
+            result.push_back({ids.at(node.first), direction_of(node.second)});
+        }
+        return result;
+    }
+
+    // deterministic nodes to recompute after name has changed, in topological order
+    std::vector<int> downstream_of(const NodeName& name) const {
+        std::vector<int> result;
+        NameSet visited;
+        std::vector<NodeName> stack{name};
+        while (!stack.empty()) {
+            auto node = stack.back();
+            stack.pop_back();
+            for (auto& child : index.children_of(node)) {
+                if (index.det(child.first) and visited.insert(child.first).second) {
+                    result.push_back(ids.at(child.first));
+                    stack.push_back(child.first);
+                }
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // name can be changed by components (it is pulled before frozen moves are performed)
+    void watch(const NodeName& name) { watched.push_back(ids.at(name)); }
+
+    // name is changed by frozen moves (it is pushed back after frozen moves are performed)
+    void publish(const NodeName& name) { published.push_back(ids.at(name)); }
+
+    void pull() {
+        bool changed = false;
+        for (auto node : watched) {
+            double x = read(node);
+            if (x != values[node]) {
+                values[node] = x;
+                changed = true;
+            }
+        }
+        if (changed) {
+            for (auto node : det_nodes) { compute(node); }
+        }
+    }
+
+    void push() {
+        for (auto node : published) {
+            if (read(node) != values[node]) { write(node); }
+        }
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ FrozenMHMove ~*~
+  Same as SimpleMHMove but on a node of a frozen program: the blanket is a precomputed list of log
+  prob terms and deterministic nodes downstream of the target are recomputed eagerly.
+==================================================================================================*/
+template <class M>
+class FrozenMHMove : public Move {
+    FrozenProgram& program;
+    int target;
+    std::vector<FrozenProgram::Term> terms;
+    std::vector<int> downstream;
+    std::vector<double> saved;  // values of downstream nodes before the move
+
+    RandomStream rng;
+    AdaptiveTuning adaptive_tuning;
+
+    // internal stats
+    int reject{0}, total{0};
+
+    double blanket_log_prob() const {
+        double result = 0;
+        for (auto& term : terms) { result += program.log_prob(term); }
+        return result;
+    }
+
+    bool mh_step(double tuning) {
+        double log_prob_before = blanket_log_prob();
+        double& x = program.value(target);
+        double bk_x = x;
+        double log_hastings = M::move(x, tuning, rng);
+        for (size_t i = 0; i < downstream.size(); i++) {
+            saved[i] = program.value(downstream[i]);
+            program.compute(downstream[i]);
+        }
+        double log_prob_after = blanket_log_prob();
+        bool accept = rng.decide(exp(log_prob_after - log_prob_before + log_hastings));
+        if (not accept) {
+            x = bk_x;
+            for (size_t i = 0; i < downstream.size(); i++) {
+                program.value(downstream[i]) = saved[i];
+            }
+            reject++;
+        }
+        total++;
+        return accept;
+    }
+
+  public:
+    FrozenMHMove(FrozenProgram& program, const NodeName& target)
+        : program(program),
+          target(program.id(target)),
+          terms(program.terms_of(target)),
+          downstream(program.downstream_of(target)),
+          saved(downstream.size()) {}
+
+    void move(double tuning = 1.0) final { mh_step(tuning); }
+
+    bool tunable() const final { return true; }
+
+    void adaptive_move(bool adapt) final {
+        bool accept = mh_step(adaptive_tuning.get());
+        if (adapt) { adaptive_tuning.update(accept); }
+    }
+
+    void seed(uint64_t key, uint64_t stream) final { rng.reset(key, stream); }
+
+    std::vector<double> get_state() const final {
+        std::vector<double> state{double(rng.tell()), double(reject), double(total)};
+        adaptive_tuning.save(state);
+        return state;
+    }
+
+    void set_state(const std::vector<double>& state) final {
+        rng.seek(uint64_t(state.at(0)));
+        reject = int(state.at(1));
+        total = int(state.at(2));
+        adaptive_tuning.load(&state.at(3));
+    }
+
+    double accept_rate() const { return double(total - reject) / total; }
+
+    double tuning() const { return adaptive_tuning.get(); }
+};
@@ -27,10 +27,15 @@ license and that you accept its terms.*/
 
 #pragma once
 
+#include <memory>
 #include "arrays.hpp"
+#include "dense_arrays.hpp"
+#include "distributions.hpp"
+#include "gm_index.hpp"
 #include "interfaces.hpp"
 #include "introspection.hpp"
 #include "node_skeletons.hpp"
+#include "suffstats.hpp"
 
 struct DirectedLogProb {
     static void _connect(tc::Assembly& a, tc::PortAddress user, tc::Address provider,
@@ -63,95 +68,338 @@ struct MoveToTarget : tc::Meta {
     }
 };
 
+// smallest partial log prob that includes all terms depending on the given ports
+LogProbSelector::Direction direction_of(const std::set<std::string>& ports) {
+    if (ports == std::set<std::string>{"a"}) {
+        return LogProbSelector::A;
+    } else if (ports == std::set<std::string>{"b"}) {
+        return LogProbSelector::B;
+    } else {
+        return LogProbSelector::Full;
+    }
+}
+
+/*
+====================================================================================================
+  ~*~ Sibling groups ~*~
+  Blanket nodes with the same distribution, the same parents and reached through the same ports are
+  scored together by a SiblingGroup component (see suffstats.hpp). Siblings that are all cells of a
+  same dense array or matrix are read from its storage (see DenseSums).
+==================================================================================================*/
+// declares a dense sibling group if all siblings are cells of the same dense composite
+template <class PDS, template <class> class DenseSiblings>
+bool declare_dense_siblings(tc::Model& m, tc::Address group, tc::Address model,
+    const std::vector<NodeName>& siblings) {
+    auto composite = first_part(siblings.front());
+    for (auto& s : siblings) {
+        if (first_part(s) != composite) { return false; }
+    }
+    tc::Address composite_address(model, tc::Address(composite));
+    tc::PortAddress values("values", group);
+    if (has_type<DenseCell<PDS>>(composite_address, m)) {
+        m.component<DenseSiblings<DenseCell<PDS>>>(group);
+        for (auto s : siblings) {
+            m.connect<tc::Use<DenseCell<PDS>>>(values, tc::Address(model, tc::Address(s)));
+        }
+    } else if (has_type<DenseObservedCell<PDS>>(composite_address, m)) {
+        m.component<DenseSiblings<DenseObservedCell<PDS>>>(group);
+        for (auto s : siblings) {
+            m.connect<tc::Use<DenseObservedCell<PDS>>>(values, tc::Address(model, tc::Address(s)));
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void declare_sibling_group(tc::Model& m, tc::Address group, tc::Address model,
+    SiblingFamily family, std::vector<NodeName> siblings, PortParents parents) {
+    bool dense = false;
+    switch (family) {
+        case gamma_ss_family:
+            dense = declare_dense_siblings<GammaShapeScaleDistribution,
+                DenseGammaShapeScaleSiblings>(m, group, model, siblings);
+            if (!dense) { m.component<GammaShapeScaleSiblings>(group); }
+            break;
+        case gamma_sr_family:
+            dense = declare_dense_siblings<GammaShapeRateDistribution,
+                DenseGammaShapeRateSiblings>(m, group, model, siblings);
+            if (!dense) { m.component<GammaShapeRateSiblings>(group); }
+            break;
+        case poisson_family:
+            dense = declare_dense_siblings<PoissonDistribution, DensePoissonSiblings>(
+                m, group, model, siblings);
+            if (!dense) { m.component<PoissonSiblings>(group); }
+            break;
+        case exp_family:
+            dense = declare_dense_siblings<ExponentialDistribution, DenseExponentialSiblings>(
+                m, group, model, siblings);
+            if (!dense) { m.component<ExponentialSiblings>(group); }
+            break;
+        case no_family: compoGM::p.fail("Sibling group %s has no family", group.c_str());
+    }
+    for (auto s : siblings) {
+        if (dense) { break; }
+        tc::Address sibling(model, tc::Address(s));
+        if (family == poisson_family) {
+            m.connect<tc::Use<Value<int>>>(tc::PortAddress("values", group), sibling);
+        } else {
+            m.connect<tc::Use<Value<double>>>(tc::PortAddress("values", group), sibling);
+        }
+    }
+    for (auto p : parents) {
+        m.connect<tc::Use<Value<double>>>(
+            tc::PortAddress(p.first, group), tc::Address(model, tc::Address(p.second)));
+    }
+}
+
+/*
+====================================================================================================
+  ~*~ Dense blankets ~*~
+  Other blanket nodes that are cells of a same dense array or matrix (and are reached through the
+  same ports) are scored by one DenseBlanket (see dense_arrays.hpp).
+==================================================================================================*/
+template <class Cell>
+bool declare_dense_blanket(tc::Model& m, tc::Address blanket, tc::Address model,
+    const NodeName& composite, const std::vector<NodeName>& cells) {
+    if (!has_type<Cell>(tc::Address(model, tc::Address(composite)), m)) { return false; }
+    m.component<DenseBlanket<Cell>>(blanket);
+    for (auto c : cells) {
+        m.connect<tc::Use<Cell>>(
+            tc::PortAddress("cells", blanket), tc::Address(model, tc::Address(c)));
+    }
+    return true;
+}
+
+// false if cells (all in composite) are not cells of a dense array or matrix
+bool declare_dense_blanket(tc::Model& m, tc::Address blanket, tc::Address model,
+    const NodeName& composite, const std::vector<NodeName>& cells) {
+    auto declare = [&](bool (*f)(tc::Model&, tc::Address, tc::Address, const NodeName&,
+                           const std::vector<NodeName>&)) {
+        return f(m, blanket, model, composite, cells);
+    };
+    return declare(declare_dense_blanket<DenseUnaryCell<ExponentialDistribution>>) or
+           declare(declare_dense_blanket<DenseUnaryCell<PoissonDistribution>>) or
+           declare(declare_dense_blanket<DenseBinaryCell<GammaShapeScaleDistribution>>) or
+           declare(declare_dense_blanket<DenseBinaryCell<GammaShapeRateDistribution>>) or
+           declare(declare_dense_blanket<DenseBinaryCell<NormalDistribution>>) or
+           declare(declare_dense_blanket<DenseObservedUnaryCell<ExponentialDistribution>>) or
+           declare(declare_dense_blanket<DenseObservedUnaryCell<PoissonDistribution>>) or
+           declare(declare_dense_blanket<DenseObservedBinaryCell<GammaShapeScaleDistribution>>) or
+           declare(declare_dense_blanket<DenseObservedBinaryCell<GammaShapeRateDistribution>>) or
+           declare(declare_dense_blanket<DenseObservedBinaryCell<NormalDistribution>>);
+}
+
+// index is the index of the graphical model (built on the fly if not provided)
 template <typename ValueType>
 struct ConnectIndividualMove : tc::Meta {
     static void connect(tc::Model& m, tc::PortAddress move, tc::Address model, tc::Address target,
-        std::set<tc::Address> used_ss = {}) {  // use_ss is target->ss
-        // getting digraph representation of graphical model
+        std::set<tc::Address> used_ss = {},  // use_ss is target->ss
+        const GMIndex* index = nullptr) {
         auto& gmref = m.get_composite(model);
-        auto digraph =
-            gmref.get_digraph();  // digraph of all components inside graphical model composite
-        auto vertices = digraph.first;
-        auto edges = digraph.second;
+        std::unique_ptr<GMIndex> local_index;
+        if (index == nullptr) {
+            local_index.reset(new GMIndex(gmref));
+            index = local_index.get();
+        }
         NodeName target_name_str = target.rebase(model).to_string();  // address of target in model
 
         // ss-related preparation
         auto is_supported = [used_ss](std::string n) {
             for (auto move : used_ss) {
-                if (move.is_ancestor(tc::Address(n))) { return true; }
+                if (move.is_ancestor(tc::Address(n))) {
+                    compoGM::p.message(
+                        "Skipping %s in blanket because it is supported by a suffstat", n.c_str());
+                    return true;
+                }
             }
             return false;
         };
 
-        // Algorithm: blanket(targets, graph) =
-        //   [prob nodes pointing to targets] U blanket([det nodes pointing to targets])
-        std::function<NameSet(NameSet)> compute_blanket = [&compute_blanket, edges, gmref,
-            is_supported](NameSet targets) {
-            if (targets.size() == 0) {
-                return NameSet{};
+        // connect move to things
+        m.connect<MoveToTarget<ValueType>>(move, target);  // to target
+
+        // grouping siblings (family, parents, ports -> nodes)
+        using SiblingKey = std::tuple<SiblingFamily, PortParents, Ports>;
+        std::map<SiblingKey, std::vector<NodeName>> siblings;
+        for (auto& c : index->blanket(target_name_str)) {
+            if (is_supported(c.first)) { continue; }
+            SiblingKey key{index->family(c.first), index->port_parents_of(c.first), c.second};
+            siblings[key].push_back(c.first);
+        }
+
+        // other nodes by composite and direction (composite -> direction -> nodes)
+        std::map<std::pair<NodeName, LogProbSelector::Direction>, std::vector<NodeName>> others;
+        int group_number = 0;
+        for (auto group : siblings) {
+            auto family = std::get<0>(group.first);
+            auto direction = direction_of(std::get<2>(group.first));
+            if (family != no_family and group.second.size() > 1) {
+                tc::Address group_address(move.address.to_string("-") + "_siblings" +
+                                          std::to_string(group_number++));
+                declare_sibling_group(
+                    m, group_address, model, family, group.second, std::get<1>(group.first));
+                m.connect<DirectedLogProb>(
+                    tc::PortAddress("logprob", move.address), group_address, direction);
+            } else {
+                for (auto c : group.second) { others[{first_part(c), direction}].push_back(c); }
+            }
+        }
+
+        int dense_number = 0;
+        for (auto group : others) {
+            auto direction = group.first.second;
+            tc::Address blanket_address(
+                move.address.to_string("-") + "_dense" + std::to_string(dense_number));
+            if (group.second.size() > 1 and
+                declare_dense_blanket(m, blanket_address, model, group.first.first, group.second)) {
+                dense_number++;
+                m.connect<DirectedLogProb>(
+                    tc::PortAddress("logprob", move.address), blanket_address, direction);
             } else {
-                NameSet partial_blanket, next_targets;
-                for (auto e : edges) {
-                    auto origin = edge_origin(e);
-                    auto dest = edge_dest(e);
-                    if (targets.count(dest) > 0) {  // points to a target
-                        if (is_prob(origin, gmref)) {
-                            if (is_supported(origin)) {
-                                compoGM::p.message(
-                                    "Skipping %s in blanket because it is supported by a suffstat",
-                                    origin.c_str());
-                            } else {
-                                partial_blanket.insert(origin);
-                            }
-                        } else if (is_det(origin, gmref)) {
-                            next_targets.insert(origin);
-                        }
-                    }
+                for (auto c : group.second) {
+                    m.connect<DirectedLogProb>(tc::PortAddress("logprob", move.address),
+                        tc::Address(model, tc::Address(c)), direction);
                 }
-                auto recursive_call = compute_blanket(next_targets);
-                partial_blanket.insert(recursive_call.begin(), recursive_call.end());
-                return partial_blanket;
             }
-        };
+        }
+    }
+};
 
-        NameSet blanket = compute_blanket(NameSet{target_name_str});
-        // std::set<std::string> short_blanket;
-        // for (auto a : blanket) { short_blanket.insert(tc::Address(a).first()); }
-        // compoGM::p.message(
-        //     "Blanket of %s is %s", target.c_str(), nameset_to_string(short_blanket).c_str());
+template <class Child>
+struct UseConjugateChild {
+    static void _connect(
+        tc::Assembly& a, tc::PortAddress user, tc::Address child, tc::Address parameter) {
+        auto& user_ref = a.at(user.address);
+        user_ref.set(user.prop, Child{&a.at<Value<typename Child::ValueType>>(child),
+                                    &a.at<Value<double>>(parameter)});
+    }
+};
 
-        // connect move to things
-        m.connect<MoveToTarget<ValueType>>(move, target);  // to target
+// child of a dense cell, given with the cell position (see DenseGibbsMove)
+template <class Child, class PDS>
+struct UseDenseConjugateChild {
+    static void _connect(tc::Assembly& a, tc::PortAddress user, tc::Address cell,
+        tc::Address child, tc::Address parameter) {
+        auto& user_ref = a.at(user.address);
+        user_ref.set(user.prop,
+            DenseConjugateChild<Child>{a.at<DenseCell<PDS>>(cell).position(),
+                Child{&a.at<Value<typename Child::ValueType>>(child),
+                    &a.at<Value<double>>(parameter)}});
+    }
+};
+
+// a move (port changes) notifies an entry of a component implementing Changes (e.g., a suffstat)
+struct NotifyChanges {
+    static void _connect(tc::Assembly& a, tc::PortAddress move, tc::Address changes, size_t entry) {
+        a.at(move.address).set(move.prop, ChangeSubscription{&a.at<Changes>(changes), entry});
+    }
+};
+
+// the prior parameters of target are nodes and all its children are conjugate (see valid_child)
+template <class Conjugacy>
+bool conjugate(const GMIndex& index, const NodeName& target) {
+    auto& parents = index.port_parents_of(target);
+    if (parents.count("a") == 0 or parents.count("b") == 0) { return false; }
+    for (auto& child : index.blanket(target)) {
+        if (!Conjugacy::valid_child(index, child.first, target)) { return false; }
+    }
+    return true;
+}
 
-        for (auto c : blanket) {
-            m.connect<DirectedLogProb>(tc::PortAddress("logprob", move.address),
-                tc::Address(model, tc::Address(c)), LogProbSelector::Full);
+template <class Conjugacy>
+struct ConnectIndividualGibbs : tc::Meta {
+    static void connect(tc::Model& m, tc::PortAddress move, tc::Address model, tc::Address target,
+        std::set<tc::Address> = {}, const GMIndex* index = nullptr) {
+        std::unique_ptr<GMIndex> local_index;
+        if (index == nullptr) {
+            local_index.reset(new GMIndex(m.get_composite(model)));
+            index = local_index.get();
+        }
+        NodeName target_name = target.rebase(model).to_string();
+
+        m.connect<tc::Use<Value<double>>>(move, target);
+        m.connect<tc::Use<Backup>>(tc::PortAddress("targetbackup", move.address), target);
+
+        auto& parents = index->port_parents_of(target_name);
+        if (parents.count("a") == 0 or parents.count("b") == 0) {
+            compoGM::p.fail("Gibbs move on %s requires a prior whose parameters are nodes",
+                target_name.c_str());
+        }
+        tc::Address prior_a(model, tc::Address(parents.at("a")));
+        tc::Address prior_b(model, tc::Address(parents.at("b")));
+        m.connect<tc::Use<Value<double>>>(tc::PortAddress("prior_a", move.address), prior_a);
+        m.connect<tc::Use<Value<double>>>(tc::PortAddress("prior_b", move.address), prior_b);
+
+        for (auto& child : index->blanket(target_name)) {
+            auto& c = child.first;
+            auto& child_parents = index->port_parents_of(c);
+            if (!Conjugacy::valid_child(*index, c, target_name)) {
+                compoGM::p.fail("Gibbs move on %s: child %s is not conjugate", target_name.c_str(),
+                    c.c_str());
+            }
+            m.connect<UseConjugateChild<typename Conjugacy::Child>>(
+                tc::PortAddress("child", move.address), tc::Address(model, tc::Address(c)),
+                tc::Address(model, tc::Address(child_parents.at(Conjugacy::parameter_port()))));
         }
     }
 };
 
-template <typename ValueType>
+// target is one cell of the cells updated by a DenseGibbsMove (priors are read from the storage)
+template <class Conjugacy, class PDS>
+struct ConnectDenseGibbs : tc::Meta {
+    static void connect(tc::Model& m, tc::PortAddress move, tc::Address model, tc::Address target,
+        const GMIndex* index) {
+        NodeName target_name = target.rebase(model).to_string();
+        m.connect<tc::Use<DenseCell<PDS>>>(move, target);
+
+        auto& parents = index->port_parents_of(target_name);
+        if (parents.count("a") == 0 or parents.count("b") == 0) {
+            compoGM::p.fail("Gibbs move on %s requires a prior whose parameters are nodes",
+                target_name.c_str());
+        }
+
+        for (auto& child : index->blanket(target_name)) {
+            auto& c = child.first;
+            auto& child_parents = index->port_parents_of(c);
+            if (!Conjugacy::valid_child(*index, c, target_name)) {
+                compoGM::p.fail("Gibbs move on %s: child %s is not conjugate", target_name.c_str(),
+                    c.c_str());
+            }
+            m.connect<UseDenseConjugateChild<typename Conjugacy::Child, PDS>>(
+                tc::PortAddress("child", move.address), target, tc::Address(model, tc::Address(c)),
+                tc::Address(model, tc::Address(child_parents.at(Conjugacy::parameter_port()))));
+        }
+    }
+};
+
+template <typename ValueType, class IndividualConnector = ConnectIndividualMove<ValueType>>
 struct ConnectMove : tc::Meta {
     static void connect(tc::Model& m, tc::PortAddress move, tc::Address model, tc::Address target,
-        std::set<tc::Address> used_ss = {}) {
+        std::set<tc::Address> used_ss = {}, const GMIndex* index = nullptr) {
+        std::unique_ptr<GMIndex> local_index;  // shared by all element moves
+        if (index == nullptr) {
+            local_index.reset(new GMIndex(m.get_composite(model)));
+            index = local_index.get();
+        }
         if (is_matrix(move.address, m)) {
             auto& tc = m.get_composite(target);
             auto element_addresses = tc.all_addresses();
             for (auto element_address : element_addresses) {
-                m.connect<ConnectIndividualMove<ValueType>>(
+                m.connect<IndividualConnector>(
                     tc::PortAddress(move.prop, tc::Address(move.address, element_address)), model,
-                    tc::Address(target, element_address), used_ss);
+                    tc::Address(target, element_address), used_ss, index);
             }
 
         } else if (is_array(move.address, m)) {
             auto target_adresses = m.get_composite(move.address).all_addresses();
             for (auto address : target_adresses) {
-                m.connect<ConnectIndividualMove<ValueType>>(
+                m.connect<IndividualConnector>(
                     tc::PortAddress(move.prop, tc::Address(move.address, address)), model,
-                    tc::Address(target, address), used_ss);
+                    tc::Address(target, address), used_ss, index);
             }
         } else {
-            m.connect<ConnectIndividualMove<ValueType>>(move, model, target, used_ss);
+            m.connect<IndividualConnector>(move, model, target, used_ss, index);
         }
     }
 };
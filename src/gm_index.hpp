@@ -0,0 +1,206 @@
+/*Copyright or © or Copr. Centre National de la Recherche Scientifique (CNRS) (2018).
+Contributors:
+* Vincent LANORE - vincent.lanore@univ-lyon1.fr
+
+This software is a component-based library to write bayesian inference programs based on the
+graphical model.
+
+This software is governed by the CeCILL-C license under French law and abiding by the rules of
+distribution of free software. You can use, modify and/ or redistribute the software under the terms
+of the CeCILL-C license as circulated by CEA, CNRS and INRIA at the following URL
+"http:////www.cecill.info".
+
+As a counterpart to the access to the source code and rights to copy, modify and redistribute
+granted by the license, users are provided only with a limited warranty and the software's author,
+the holder of the economic rights, and the successive licensors have only limited liability.
+
+In this respect, the user's attention is drawn to the risks associated with loading, using,
+modifying and/or developing or reproducing the software by the user in light of its specific status
+of free software, that may mean that it is complicated to manipulate, and that also therefore means
+that it is reserved for developers and experienced professionals having in-depth computer knowledge.
+Users are therefore encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or data to be ensured and,
+more generally, to use and operate it in the same conditions as regards security.
+
+The fact that you are presently reading this means that you have had knowledge of the CeCILL-C
+license and that you accept its terms.*/
+
+#pragma once
+
+#include "dense_arrays.hpp"
+#include "distributions.hpp"
+#include "introspection.hpp"
+#include "node_skeletons.hpp"
+#include "static_model.hpp"
+
+/*
+====================================================================================================
+  ~*~ Node families ~*~
+  Distribution of a node whatever its storage (regular, observed, dense or static node).
+==================================================================================================*/
+enum SiblingFamily { no_family, gamma_ss_family, gamma_sr_family, poisson_family, exp_family };
+
+template <class PDS>
+bool is_binary_node_of(tc::Address a, const tc::Model& m) {
+    return has_type<BinaryNode<PDS>>(a, m) or has_type<ObservedBinaryNode<PDS>>(a, m) or
+           has_type<DenseBinaryCell<PDS>>(a, m) or has_type<DenseObservedBinaryCell<PDS>>(a, m) or
+           has_type<StaticBinaryOf<PDS>>(a, m);
+}
+
+template <class PDS>
+bool is_unary_node_of(tc::Address a, const tc::Model& m) {
+    return has_type<UnaryNode<PDS>>(a, m) or has_type<ObservedUnaryNode<PDS>>(a, m) or
+           has_type<DenseUnaryCell<PDS>>(a, m) or has_type<DenseObservedUnaryCell<PDS>>(a, m) or
+           has_type<StaticUnaryOf<PDS>>(a, m);
+}
+
+SiblingFamily sibling_family(NodeName node, const tc::Model& gmref) {
+    tc::Address a(node);
+    if (is_binary_node_of<GammaShapeScaleDistribution>(a, gmref)) { return gamma_ss_family; }
+    if (is_binary_node_of<GammaShapeRateDistribution>(a, gmref)) { return gamma_sr_family; }
+    if (is_unary_node_of<PoissonDistribution>(a, gmref)) { return poisson_family; }
+    if (is_unary_node_of<ExponentialDistribution>(a, gmref)) { return exp_family; }
+    return no_family;
+}
+
+/*
+====================================================================================================
+  ~*~ GMIndex ~*~
+  Index of a graphical model composite built once from its digraph and its port connections:
+  parents, children (with the ports they are connected through), node kinds and families. Blankets
+  are memoized so that declaring moves on all nodes of a model is linear in the size of the graph.
+==================================================================================================*/
+using Ports = std::set<std::string>;
+using DirectedBlanket = std::map<NodeName, Ports>;  // blanket node -> ports it is reached through
+using PortParents = std::map<std::string, NodeName>;  // port name -> provider
+
+class GMIndex {
+    std::map<NodeName, NameSet> parents;
+    std::map<NodeName, PortParents> port_parents;
+    std::map<NodeName, std::map<NodeName, Ports>> children;
+    NameSet all_nodes, prob_nodes, det_nodes, cached_nodes;
+    NameSet normal_nodes, product_nodes;
+    std::map<NodeName, SiblingFamily> families;
+
+    mutable std::map<NodeName, DirectedBlanket> blankets;
+
+    NameSet no_nodes;
+    PortParents no_ports;
+    std::map<NodeName, Ports> no_children;
+
+  public:
+    GMIndex(const tc::Model& gm) {
+        auto digraph = gm.get_digraph();  // edges go from user to provider
+        for (auto vertex : digraph.first) {
+            all_nodes.insert(vertex);
+            tc::Address address(vertex);
+            if (is_prob(address, gm)) {
+                prob_nodes.insert(vertex);
+                families[vertex] = sibling_family(vertex, gm);
+                if (is_binary_node_of<NormalDistribution>(address, gm)) {
+                    normal_nodes.insert(vertex);
+                }
+            } else if (is_det(address, gm)) {
+                det_nodes.insert(vertex);
+                // deterministic nodes update their cache when read
+                if (has_type<Cached>(address, gm)) {
+                    cached_nodes.insert(vertex);
+                }
+                if (has_type<ProductOfParents>(address, gm)) { product_nodes.insert(vertex); }
+            }
+        }
+        tc::Introspector i(gm);
+        for (auto binop : i.directed_binops()) {
+            auto origin = binop.first.address.to_string();
+            auto dest = binop.second.to_string();
+            port_parents[origin][binop.first.prop] = dest;
+            children[dest][origin].insert(binop.first.prop);
+        }
+        for (auto edge : digraph.second) {
+            auto origin = edge_origin(edge);
+            auto dest = edge_dest(edge);
+            parents[origin].insert(dest);
+            auto& ports = children[dest][origin];
+            if (ports.empty()) { ports.insert(""); }  // not a port connection
+        }
+    }
+
+    const NameSet& parents_of(const NodeName& node) const {
+        auto it = parents.find(node);
+        return (it == parents.end()) ? no_nodes : it->second;
+    }
+
+    const PortParents& port_parents_of(const NodeName& node) const {
+        auto it = port_parents.find(node);
+        return (it == port_parents.end()) ? no_ports : it->second;
+    }
+
+    const std::map<NodeName, Ports>& children_of(const NodeName& node) const {
+        auto it = children.find(node);
+        return (it == children.end()) ? no_children : it->second;
+    }
+
+    const NameSet& nodes() const { return all_nodes; }
+
+    bool prob(const NodeName& node) const { return prob_nodes.count(node) > 0; }
+    bool det(const NodeName& node) const { return det_nodes.count(node) > 0; }
+    bool cached(const NodeName& node) const { return cached_nodes.count(node) > 0; }
+
+    SiblingFamily family(const NodeName& node) const {
+        auto it = families.find(node);
+        return (it == families.end()) ? no_family : it->second;
+    }
+
+    bool poisson(const NodeName& node) const { return family(node) == poisson_family; }
+    bool normal(const NodeName& node) const { return normal_nodes.count(node) > 0; }
+
+    // node is target or a deterministic function of it
+    bool depends_on(const NodeName& node, const NodeName& target) const {
+        if (node == target) { return true; }
+        if (!det(node)) { return false; }
+        for (auto& parent : parents_of(node)) {
+            if (depends_on(parent, target)) { return true; }
+        }
+        return false;
+    }
+
+    // node is c * target where c does not depend on target: node is target, or a product whose
+    // parents (counted once per port) include exactly one proportional to target and no other
+    // one depending on it
+    bool proportional(const NodeName& node, const NodeName& target) const {
+        if (node == target) { return true; }
+        if (product_nodes.count(node) == 0) { return false; }
+        int nb_dependent = 0;
+        for (auto& parent : port_parents_of(node)) {
+            if (depends_on(parent.second, target)) {
+                if (!proportional(parent.second, target)) { return false; }
+                nb_dependent++;
+            }
+        }
+        return nb_dependent == 1;
+    }
+
+    // Algorithm: blanket(target, graph) =
+    //   [prob nodes pointing to target] U blanket([det nodes pointing to target])
+    // along with the ports of blanket nodes through which target has an influence
+    const DirectedBlanket& blanket(const NodeName& target) const {
+        auto it = blankets.find(target);
+        if (it != blankets.end()) { return it->second; }
+
+        DirectedBlanket result;
+        NameSet visited{target};
+        std::vector<NodeName> stack{target};
+        while (!stack.empty()) {
+            auto node = stack.back();
+            stack.pop_back();
+            for (auto& child : children_of(node)) {
+                if (prob(child.first)) {
+                    result[child.first].insert(child.second.begin(), child.second.end());
+                } else if (det(child.first) and visited.insert(child.first).second) {
+                    stack.push_back(child.first);
+                }
+            }
+        }
+        return blankets[target] = result;
+    }
+};
@@ -0,0 +1,214 @@
+/*Copyright or © or Copr. Centre National de la Recherche Scientifique (CNRS) (2018).
+Contributors:
+* Vincent LANORE - vincent.lanore@univ-lyon1.fr
+
+This software is a component-based library to write bayesian inference programs based on the
+graphical model.
+
+This software is governed by the CeCILL-C license under French law and abiding by the rules of
+distribution of free software. You can use, modify and/ or redistribute the software under the terms
+of the CeCILL-C license as circulated by CEA, CNRS and INRIA at the following URL
+"http:////www.cecill.info".
+
+As a counterpart to the access to the source code and rights to copy, modify and redistribute
+granted by the license, users are provided only with a limited warranty and the software's author,
+the holder of the economic rights, and the successive licensors have only limited liability.
+
+In this respect, the user's attention is drawn to the risks associated with loading, using,
+modifying and/or developing or reproducing the software by the user in light of its specific status
+of free software, that may mean that it is complicated to manipulate, and that also therefore means
+that it is reserved for developers and experienced professionals having in-depth computer knowledge.
+Users are therefore encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or data to be ensured and,
+more generally, to use and operate it in the same conditions as regards security.
+
+The fact that you are presently reading this means that you have had knowledge of the CeCILL-C
+license and that you accept its terms.*/
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "computing_entity.hpp"
+
+/*
+====================================================================================================
+  ~*~ IndexDictionary ~*~
+  Interns the names of an index (genes, samples, conditions...) once at load time: each name gets a
+  dense integer id, and ids are given in name order so that iterating on ids is iterating on names
+  in alphabetical order (which is the order tinycompo uses for composite elements). Containers and
+  connectors work on ids, names are only needed for component addresses, traces and logs.
+==================================================================================================*/
+using Index = int;
+
+class IndexDictionary {
+    std::vector<std::string> _names;  // id -> name
+    std::unordered_map<std::string, Index> ids;
+
+  public:
+    IndexDictionary(std::vector<std::string> names) : _names(std::move(names)) {
+        std::sort(_names.begin(), _names.end());
+        _names.erase(std::unique(_names.begin(), _names.end()), _names.end());
+        ids.reserve(_names.size());
+        for (size_t i = 0; i < _names.size(); i++) { ids[_names[i]] = Index(i); }
+    }
+
+    Index id(const std::string& name) const {
+        auto it = ids.find(name);
+        if (it == ids.end()) { compoGM::p.fail("IndexDictionary: unknown name %s", name.c_str()); }
+        return it->second;
+    }
+
+    bool contains(const std::string& name) const { return ids.find(name) != ids.end(); }
+
+    const std::string& name(Index id) const { return _names.at(id); }
+
+    const std::vector<std::string>& names() const { return _names; }
+
+    size_t size() const { return _names.size(); }
+};
+
+using Dictionary = std::shared_ptr<const IndexDictionary>;
+
+/*
+====================================================================================================
+  ~*~ IndexSet ~*~
+  Set of ids of a dictionary, iterated in increasing order (i.e., in name order).
+==================================================================================================*/
+class IndexSet {
+    Dictionary dict;
+    std::vector<Index> ids;  // increasing
+
+  public:
+    IndexSet() = default;
+
+    // all indices of the dictionary
+    explicit IndexSet(Dictionary dict) : dict(dict), ids(dict->size()) {
+        for (size_t i = 0; i < ids.size(); i++) { ids[i] = Index(i); }
+    }
+
+    IndexSet(Dictionary dict, std::vector<Index> indices) : dict(dict), ids(std::move(indices)) {
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+
+    using const_iterator = std::vector<Index>::const_iterator;
+    const_iterator begin() const { return ids.begin(); }
+    const_iterator end() const { return ids.end(); }
+    size_t size() const { return ids.size(); }
+    bool empty() const { return ids.empty(); }
+    Index operator[](size_t i) const { return ids[i]; }
+
+    bool contains(Index id) const { return std::binary_search(ids.begin(), ids.end(), id); }
+
+    const std::string& name(Index id) const { return dict->name(id); }
+
+    const Dictionary& dictionary() const { return dict; }
+
+    // elements at positions [begin, end)
+    IndexSet subset(size_t begin, size_t end) const {
+        return IndexSet(dict, std::vector<Index>(ids.begin() + begin, ids.begin() + end));
+    }
+
+    // union of two sets of the same dictionary
+    IndexSet merge(const IndexSet& other) const {
+        std::vector<Index> result(ids);
+        result.insert(result.end(), other.ids.begin(), other.ids.end());
+        return IndexSet(dict != nullptr ? dict : other.dict, result);
+    }
+
+    // same names (sets may come from different dictionaries)
+    bool operator==(const IndexSet& other) const {
+        if (size() != other.size()) { return false; }
+        for (size_t i = 0; i < size(); i++) {
+            if (name(ids[i]) != other.name(other.ids[i])) { return false; }
+        }
+        return true;
+    }
+    bool operator!=(const IndexSet& other) const { return !(*this == other); }
+};
+
+IndexSet make_index_set(const std::vector<std::string>& names) {
+    return IndexSet(std::make_shared<IndexDictionary>(names));
+}
+
+/*
+====================================================================================================
+  ~*~ IndexMapping ~*~
+  Maps ids of a dictionary to ids of another one (e.g., sample -> condition).
+==================================================================================================*/
+class IndexMapping {
+    Dictionary from, to;
+    std::vector<Index> mapping;  // -1 if unmapped
+
+  public:
+    IndexMapping() = default;
+
+    IndexMapping(Dictionary from, Dictionary to) : from(from), to(to), mapping(from->size(), -1) {}
+
+    void set(Index i, Index j) { mapping.at(i) = j; }
+
+    Index at(Index i) const {
+        Index result = mapping.at(i);
+        if (result < 0) { compoGM::p.fail("IndexMapping: %s is unmapped", from->name(i).c_str()); }
+        return result;
+    }
+
+    // name boundary, used when connecting components
+    const std::string& target_name(const std::string& name) const {
+        return to->name(at(from->id(name)));
+    }
+
+    const Dictionary& source() const { return from; }
+    const Dictionary& target() const { return to; }
+};
+
+/*
+====================================================================================================
+  ~*~ Indexed data ~*~
+  Dense data arrays and matrices indexed by ids, e.g., counts (gene x sample) or size factors (by
+  sample). Values can be looked up by name when connecting them to components.
+==================================================================================================*/
+template <class T>
+class IndexedArray {
+    Dictionary dict;
+    std::vector<T> values;
+
+  public:
+    IndexedArray() = default;
+
+    IndexedArray(Dictionary dict, T init = T()) : dict(dict), values(dict->size(), init) {}
+
+    T& operator[](Index i) { return values[i]; }
+    const T& operator[](Index i) const { return values[i]; }
+
+    const T& at(const std::string& name) const { return values.at(dict->id(name)); }
+
+    const Dictionary& dictionary() const { return dict; }
+    size_t size() const { return values.size(); }
+};
+
+template <class T>
+class IndexedMatrix {
+    Dictionary _rows, _cols;
+    std::vector<T> values;  // row-major
+
+  public:
+    IndexedMatrix() = default;
+
+    IndexedMatrix(Dictionary rows, Dictionary cols, T init = T())
+        : _rows(rows), _cols(cols), values(rows->size() * cols->size(), init) {}
+
+    T& operator()(Index i, Index j) { return values[i * _cols->size() + j]; }
+    const T& operator()(Index i, Index j) const { return values[i * _cols->size() + j]; }
+
+    const T& at(const std::string& row, const std::string& col) const {
+        return values.at(_rows->id(row) * _cols->size() + _cols->id(col));
+    }
+
+    const IndexDictionary& rows() const { return *_rows; }
+    const IndexDictionary& cols() const { return *_cols; }
+};
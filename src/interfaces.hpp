@@ -26,8 +26,12 @@ The fact that you are presently reading this means that you have had knowledge o
 license and that you accept its terms.*/
 
 #pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <vector>
 
 /*
 ====================================================================================================
@@ -41,10 +45,20 @@ struct Go {
 /*
 ====================================================================================================
   ~*~ Go interface ~*~
-  Used to start a move with tuning.
+  Used to start a move with tuning. Each move draws from its own random stream, so that results do
+  not depend on the order in which independent moves are performed.
 ==================================================================================================*/
 struct Move {
     virtual void move(double tuning = 1.0) = 0;
+    // move with a proposal width tuned toward a target acceptance rate; the width is updated only
+    // while adapt is true (i.e., during burn-in) and remains frozen afterwards
+    virtual void adaptive_move(bool adapt) = 0;
+    virtual bool tunable() const = 0;  // false if the move does not depend on tuning (e.g., Gibbs)
+    virtual void seed(uint64_t key, uint64_t stream) = 0;
+    // state of the move besides its target (tuning, position in its random stream...), used to
+    // resume the move in another process; set_state takes what get_state returned
+    virtual std::vector<double> get_state() const { return {}; }
+    virtual void set_state(const std::vector<double>&) {}
 };
 
 /*
@@ -74,12 +88,100 @@ struct Value {
 /*
 ====================================================================================================
   ~*~ Backup interface ~*~
+  Backup is expected to be called right before the value is changed (e.g., by a move), so that
+  versioned nodes can use it to signal the change.
 ==================================================================================================*/
 struct Backup {
     virtual void backup() = 0;
     virtual void restore() = 0;
 };
 
+/*
+====================================================================================================
+  ~*~ Versioned interface ~*~
+  Used to know if a value might have changed since last time it was read (e.g., to avoid
+  recomputing deterministic nodes). Versions never decrease.
+==================================================================================================*/
+struct Versioned {
+    virtual size_t get_version() const = 0;
+    virtual void bump_version() = 0;  // <- to call after writing a value directly through get_ref
+};
+
+// signals that a value was overwritten (if it is versioned)
+template <class ValueType>
+void bump_version(Value<ValueType>* ptr) {
+    auto versioned = dynamic_cast<Versioned*>(ptr);
+    if (versioned != nullptr) { versioned->bump_version(); }
+}
+
+// version to use for things that are not versioned: it is different every time it is requested
+size_t unversioned() {
+    static std::atomic<size_t> counter{0};
+    return ++counter;
+}
+
+size_t version_of(const Versioned* ptr) {
+    return (ptr != nullptr) ? ptr->get_version() : unversioned();
+}
+
+/*
+====================================================================================================
+  ~*~ Changes interface ~*~
+  Implemented by components that keep values computed from many nodes (e.g., suffstats), so that
+  they are told which of their entries changed instead of checking all of them. Moves notify the
+  entries their target feeds into (see ChangeSubscribers) every time they change their target.
+==================================================================================================*/
+struct Changes {
+    virtual void changed(size_t entry) = 0;
+    virtual void reset() = 0;  // <- any entry might have changed (e.g., values were migrated)
+};
+
+struct ChangeSubscription {
+    Changes* changes;
+    size_t entry;
+};
+
+class ChangeSubscribers {
+    std::vector<ChangeSubscription> subscriptions;
+
+  public:
+    void add(ChangeSubscription s) { subscriptions.push_back(s); }
+    void notify() const {
+        for (auto& s : subscriptions) { s.changes->changed(s.entry); }
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ Cached interface ~*~
+  Marks nodes that update a cache when their value is read: reading them counts as writing them when
+  looking for moves that can be performed in parallel (see coloring.hpp).
+==================================================================================================*/
+struct Cached {
+    virtual ~Cached() = default;
+};
+
+/*
+====================================================================================================
+  ~*~ ProductOfParents interface ~*~
+  Marks deterministic nodes whose value is the product of their parents, so that a child of such a
+  node can be recognized as depending linearly on each parent (e.g., for conjugate updates).
+==================================================================================================*/
+struct ProductOfParents {
+    virtual ~ProductOfParents() = default;
+};
+
+/*
+====================================================================================================
+  ~*~ VersionedLogProb interface ~*~
+  Used to know if a log prob might have changed since it was last computed. Typically, it is the
+  sum of the versions of the node and of its parents (as versions never decrease, the sum changes
+  as soon as one of them changes).
+==================================================================================================*/
+struct VersionedLogProb {
+    virtual size_t get_log_prob_version() const = 0;
+};
+
 /*
 ====================================================================================================
   ~*~ Proxy interface ~*~
@@ -101,11 +203,21 @@ class LogProbSelector : public LogProb {
   private:
     Direction d;
     LogProb* ptr;
+    const VersionedLogProb* versioned;
 
   public:
-    LogProbSelector(Direction d = Invalid, LogProb* ptr = nullptr) : d(d), ptr(ptr) {}
+    LogProbSelector(Direction d = Invalid, LogProb* ptr = nullptr)
+        : d(d), ptr(ptr), versioned(dynamic_cast<const VersionedLogProb*>(ptr)) {}
     virtual ~LogProbSelector() = default;
 
+    size_t get_log_prob_version() const {
+        return (versioned != nullptr) ? versioned->get_log_prob_version() : unversioned();
+    }
+
+    Direction get_direction() const { return d; }
+
+    LogProb* get_ptr() const { return ptr; }
+
     double get_log_prob() final {
         switch (d) {
             case X: return ptr->get_log_prob_x();
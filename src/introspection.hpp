@@ -32,6 +32,7 @@ license and that you accept its terms.*/
 using NodeName = std::string;
 using NameSet = std::set<NodeName>;
 using Edge = std::pair<const NodeName, NodeName>;
+using Edges = std::multimap<NodeName, NodeName>;
 
 NodeName edge_origin(Edge& edge) { return tc::Address(edge.first).to_string(); }
 
@@ -62,6 +63,14 @@ bool is_matrix(tc::Address a, const tc::Model& m) {
 
 bool is_array(tc::Address a, const tc::Model& m) { return !is_matrix(a, m) and m.is_composite(a); }
 
+// index of the array element an address belongs to (e.g., gene of tau_move__gene__sample), or ""
+std::string element_of(const tc::Address& a) { return a.is_composite() ? a.rest().first() : ""; }
+
+// same, relative to a composite (e.g., gene of model__tau__gene__sample relative to model)
+std::string element_of(const tc::Address& a, const tc::Address& root) {
+    return root.is_ancestor(a) ? element_of(a.rebase(root)) : "";
+}
+
 IndexSet get_array_indices(tc::Address a, const tc::Model& m) {
     auto names = m.get_composite(a).all_component_names();
     return make_index_set(names);
@@ -27,12 +27,18 @@ license and that you accept its terms.*/
 
 #pragma once
 
+#include "arena.hpp"
 #include "chrono.hpp"
+#include "coloring.hpp"
+#include "dense_arrays.hpp"
+#include "distributions.hpp"
+#include "frozen.hpp"
 #include "gm_connectors.hpp"
 #include "introspection.hpp"
 #include "mcmc_moves.hpp"
 #include "moves.hpp"
 #include "suffstats.hpp"
+#include "thread_helpers.hpp"
 #include "tinycompo.hpp"
 #include "trace.hpp"
 using tc::Use;
@@ -40,9 +46,9 @@ using tc::Use;
 class MCMC;
 
 namespace compoGM {
-    enum MoveType { scale, shift };
+    enum MoveType { scale, shift, gibbs, custom };  // custom: move component given by the user
     enum DataType { integer, fp };
-    enum SuffstatType { gamma_ss, gamma_sr, poisson };
+    enum SuffstatType { gamma_ss, gamma_sr, poisson, normal };
 
     struct _MoveDecl {
         tc::Address target;
@@ -50,6 +56,7 @@ namespace compoGM {
         compoGM::DataType data_type;
         int move_rep;
         double tuning_mult;
+        std::function<void(const MCMC&, tc::Address, tc::Address)> create;  // custom moves only
     };
 
     struct _SuffstatDecl {
@@ -66,18 +73,127 @@ class MCMC {
     std::vector<compoGM::_MoveDecl> moves;
     std::vector<compoGM::_SuffstatDecl> suffstats;
     std::map<tc::Address, std::pair<tc::Address, tc::Address>> ss_usage;  // move->(target, ss)
+    int nb_threads{1};
+    uint64_t random_seed{global_seed}, chain{0};
+    int burn_in{-1};  // number of adaptation iterations, -1 if moves are not adaptive
+    bool detect_suffstats{true};
+    bool freeze_model{false};
+    bool use_arena{false}, huge_pages{false};
+
+    using Sweep = std::vector<std::vector<Move*>>;  // sets of moves that can be done in parallel
+
+    // nodes read through suffstats by moves, in addition to their blanket (target -> nodes)
+    mutable std::map<NodeName, NameSet> suffstat_reads;
+
+    // element (e.g., gene) of the values of each suffstat group (see element_key)
+    mutable std::map<std::string, std::string> suffstat_elements;
+
+    // targets whose moves notify suffstat entries of their changes (they cannot be frozen)
+    mutable std::set<tc::Address> notifying_targets;
+
+    // element a component belongs to, used to place components of a same element next to each
+    // other in the arena: nodes of the graphical model, element moves of arrays (target_move, see
+    // individual_moves), their sibling groups and dense blankets (target_move-element-..._siblingsN
+    // and _denseN, see ConnectIndividualMove) and suffstat groups; "" for other components
+    std::string element_key(const tc::Address& address) const {
+        if (gm.is_ancestor(address)) { return element_of(address, gm); }
+        auto ss = suffstat_elements.find(address.to_string());
+        if (ss != suffstat_elements.end()) { return ss->second; }
+        auto name = address.first();
+        auto ends_with = [&name](const std::string& suffix) {
+            return name.size() > suffix.size() and
+                   name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+        };
+        if (ends_with("_move")) { return element_of(address); }
+        auto group = name.rfind("_siblings");
+        if (group == std::string::npos) { group = name.rfind("_dense"); }
+        if (group != std::string::npos) {
+            auto move = name.substr(0, group);  // individual move address, joined by "-"
+            auto start = move.find("_move-");
+            if (start == std::string::npos) { return ""; }
+            start += 6;
+            return move.substr(start, move.find('-', start) - start);
+        }
+        return "";
+    }
 
-    template <class MoveType>
+    template <class MoveComponent>
     void adaptive_create(tc::Address move_address, tc::Address target) const {
         if (is_matrix(target, model)) {
             auto indices = get_matrix_indices(target, model);
-            model.component<Matrix<SimpleMHMove<MoveType>>>(
-                move_address, indices.first, indices.second);
+            model.component<Matrix<MoveComponent>>(move_address, indices.first, indices.second);
         } else if (is_array(target, model)) {
             auto indices = get_array_indices(target, model);
-            model.component<Array<SimpleMHMove<MoveType>>>(move_address, indices);
+            model.component<Array<MoveComponent>>(move_address, indices);
+        } else {
+            model.component<MoveComponent>(move_address);
+        }
+    }
+
+    // elements of target that are not conjugate make the whole move fall back to a MH move; dense
+    // arrays get one DenseGibbsMove, dense matrices one per row
+    template <class Conjugacy, class FallbackMove, class PDS>
+    void declare_gibbs(tc::PortAddress mp, tc::Address target, std::set<tc::Address> used_ss,
+        const GMIndex& index) const {
+        tc::Address target_glob(gm, target);
+        std::vector<NodeName> elements;
+        if (model.is_composite(target_glob)) {
+            for (auto e : model.get_composite(target_glob).all_addresses()) {
+                elements.push_back(tc::Address(target, e).to_string());
+            }
+        } else {
+            elements.push_back(target.to_string());
+        }
+        for (auto& e : elements) {
+            if (!conjugate<Conjugacy>(index, e)) {
+                compoGM::p.message("Gibbs move on %s: %s is not conjugate, using MH moves instead",
+                    target.c_str(), e.c_str());
+                adaptive_create<SimpleMHMove<FallbackMove>>(mp.address, target_glob);
+                model.connect<ConnectMove<double>>(mp, gm, target_glob, used_ss, &index);
+                return;
+            }
+        }
+        if (has_type<DenseCell<PDS>>(target_glob, model)) {
+            bool matrix = is_matrix(target_glob, model);
+            if (matrix) {
+                auto rows = get_matrix_indices(target_glob, model).first;
+                model.component<Array<DenseGibbsMove<Conjugacy, PDS>>>(mp.address, rows);
+            } else {
+                model.component<DenseGibbsMove<Conjugacy, PDS>>(mp.address);
+            }
+            for (auto e : model.get_composite(target_glob).all_addresses()) {
+                tc::Address move = matrix ? tc::Address(mp.address, e.first()) : mp.address;
+                model.connect<ConnectDenseGibbs<Conjugacy, PDS>>(
+                    tc::PortAddress(mp.prop, move), gm, tc::Address(target_glob, e), &index);
+            }
+            return;
+        }
+        adaptive_create<GibbsMove<Conjugacy>>(mp.address, target_glob);
+        model.connect<ConnectMove<double, ConnectIndividualGibbs<Conjugacy>>>(
+            mp, gm, target_glob, std::set<tc::Address>{}, &index);
+    }
+
+    // picks the conjugate update matching the prior of target
+    void declare_gibbs(tc::PortAddress mp, tc::Address target, std::set<tc::Address> used_ss,
+        const GMIndex& index) const {
+        tc::Address target_glob(gm, target);
+        if (has_type<BinaryNode<GammaShapeScaleDistribution>>(target_glob, model) or
+            has_type<DenseBinaryCell<GammaShapeScaleDistribution>>(target_glob, model) or
+            has_type<StaticBinaryOf<GammaShapeScaleDistribution>>(target_glob, model)) {
+            declare_gibbs<GammaShapeScalePoissonConjugacy, Scale, GammaShapeScaleDistribution>(
+                mp, target, used_ss, index);
+        } else if (has_type<BinaryNode<GammaShapeRateDistribution>>(target_glob, model) or
+                   has_type<DenseBinaryCell<GammaShapeRateDistribution>>(target_glob, model) or
+                   has_type<StaticBinaryOf<GammaShapeRateDistribution>>(target_glob, model)) {
+            declare_gibbs<GammaShapeRatePoissonConjugacy, Scale, GammaShapeRateDistribution>(
+                mp, target, used_ss, index);
+        } else if (has_type<BinaryNode<NormalDistribution>>(target_glob, model) or
+                   has_type<DenseBinaryCell<NormalDistribution>>(target_glob, model) or
+                   has_type<StaticBinaryOf<NormalDistribution>>(target_glob, model)) {
+            declare_gibbs<NormalNormalConjugacy, Shift, NormalDistribution>(
+                mp, target, used_ss, index);
         } else {
-            model.component<SimpleMHMove<MoveType>>(move_address);
+            compoGM::p.fail("No conjugate update available for %s", target_glob.c_str());
         }
     }
 
@@ -86,7 +202,17 @@ class MCMC {
 
     void move(tc::Address target, compoGM::MoveType move_type,
         compoGM::DataType data_type = compoGM::fp, int move_rep = 1, double tuning_mult = 1.0) {
-        moves.push_back({target, move_type, data_type, move_rep, tuning_mult});
+        moves.push_back({target, move_type, data_type, move_rep, tuning_mult, nullptr});
+    }
+
+    // move performed by a given move component (e.g., a StaticMHMove, see static_model.hpp) that is
+    // connected to its target like other MH moves
+    template <class MoveComponent>
+    void move(tc::Address target, compoGM::DataType data_type = compoGM::fp) {
+        moves.push_back({target, compoGM::custom, data_type, 1, 1.0,
+            [](const MCMC& mcmc, tc::Address move_address, tc::Address target_glob) {
+                mcmc.adaptive_create<MoveComponent>(move_address, target_glob);
+            }});
     }
 
     void suffstat(
@@ -95,55 +221,205 @@ class MCMC {
         for (auto m : affected_moves) { ss_usage[m] = {target, target.last() + "_suffstats"}; }
     }
 
-    void declare_suffstat(tc::Address target, std::set<tc::Address> affected_moves,
-        compoGM::SuffstatType type) const {
-        compoGM::p.message("Adding sufftsat on %s in model %s", target.c_str(), gm.c_str());
+    template <class Suffstat>
+    void adaptive_create_suffstat(tc::Address ss_address, size_t nb_groups) const {
+        if (nb_groups == 1) {
+            model.component<Suffstat>(ss_address);
+        } else {
+            std::vector<std::string> names;
+            for (size_t i = 0; i < nb_groups; i++) { names.push_back(std::to_string(i)); }
+            model.component<Array<Suffstat>>(ss_address, make_index_set(names));
+        }
+    }
+
+    // node and the deterministic nodes depending on it
+    NameSet downstream(const NodeName& node, const GMIndex& index) const {
+        NameSet result{node};
+        std::vector<NodeName> stack{node};
+        while (!stack.empty()) {
+            auto current = stack.back();
+            stack.pop_back();
+            for (auto& child : index.children_of(current)) {
+                if (index.det(child.first) and result.insert(child.first).second) {
+                    stack.push_back(child.first);
+                }
+            }
+        }
+        return result;
+    }
+
+    // node if it is not deterministic, otherwise the other nodes it depends on through
+    // deterministic nodes
+    NameSet upstream(const NodeName& node, const GMIndex& index) const {
+        NameSet result, visited{node};
+        std::vector<NodeName> stack{node};
+        while (!stack.empty()) {
+            auto current = stack.back();
+            stack.pop_back();
+            if (!index.det(current)) {
+                result.insert(current);
+                continue;
+            }
+            for (auto parent : index.parents_of(current)) {
+                if (visited.insert(parent).second) { stack.push_back(parent); }
+            }
+        }
+        return result;
+    }
 
+    // target can be a single node, an array or a matrix; its elements are grouped by parents (one
+    // suffstat per group) and each element move uses the suffstats of groups it is a parent of
+    // (normal suffstats take one mean per element, so elements are grouped by their other parents)
+    void declare_suffstat(tc::Address target, std::set<tc::Address> affected_moves,
+        compoGM::SuffstatType type, const GMIndex& index) const {
         tc::Address ss_address(target.to_string("-") + "_suffstats");
         tc::Address target_glob(gm, target);
-        switch (type) {  // declaring suffstat component
-            case compoGM::gamma_sr: model.component<GammaShapeRateSuffstat>(ss_address); break;
-            case compoGM::gamma_ss: model.component<GammaShapeScaleSuffstat>(ss_address); break;
-            case compoGM::poisson: model.component<PoissonSuffstat>(ss_address); break;
-        }
 
-        // computing target's parents
-        tc::Introspector i(model.get_composite(gm));
-        auto edges = i.directed_binops();
-        std::map<std::string, tc::Address> parents;  // key is the portname associated to the parent
-        for (auto edge : edges) {
-            if (target.is_ancestor(edge.first.address)) {
-                parents[edge.first.prop] = tc::Address(gm, edge.second);
+        // elements of target grouped by parents (parents are port name -> node)
+        std::vector<NodeName> elements;
+        if (model.is_composite(target_glob)) {
+            for (auto e : model.get_composite(target_glob).all_addresses()) {
+                elements.push_back(tc::Address(target, e).to_string());
             }
+        } else {
+            elements.push_back(target.to_string());
         }
-        for (auto p : parents) {
-            compoGM::p.message(
-                "Parent %s of %s is %s", p.first.c_str(), target.c_str(), p.second.c_str());
+        std::map<PortParents, std::vector<NodeName>> groups;
+        for (auto e : elements) {
+            auto key = index.port_parents_of(e);
+            if (type == compoGM::normal) { key.erase("a"); }
+            groups[key].push_back(e);
         }
+        compoGM::p.message("Adding sufftsat on %s in model %s (%d groups)", target.c_str(),
+            gm.c_str(), int(groups.size()));
 
-        switch (type) {
+        switch (type) {  // declaring suffstat components
             case compoGM::gamma_sr:
+                adaptive_create_suffstat<GammaShapeRateSuffstat>(ss_address, groups.size());
+                break;
             case compoGM::gamma_ss:
-                model.connect<AdaptiveOneToMany<Use<Value<double>>>>(
-                    tc::PortAddress("values", ss_address), target_glob);
+                adaptive_create_suffstat<GammaShapeScaleSuffstat>(ss_address, groups.size());
                 break;
             case compoGM::poisson:
-                model.connect<AdaptiveOneToMany<Use<Value<int>>>>(
-                    tc::PortAddress("values", ss_address), target_glob);
+                adaptive_create_suffstat<PoissonSuffstat>(ss_address, groups.size());
+                break;
+            case compoGM::normal:
+                adaptive_create_suffstat<NormalSuffstat>(ss_address, groups.size());
                 break;
         }
-        for (auto p : parents) {
-            model.connect<Use<Value<double>>>(tc::PortAddress(p.first, ss_address), p.second);
+
+        // parent -> groups it is a parent of -> through which ports
+        std::map<NodeName, std::map<tc::Address, std::set<std::string>>> groups_of_parent;
+        std::map<tc::Address, NameSet> group_inputs;
+        // node -> (group, entry) of the entries it feeds into, and nodes each entry depends on
+        std::map<NodeName, std::vector<std::pair<tc::Address, size_t>>> entries_of;
+        std::vector<std::pair<std::pair<tc::Address, size_t>, NameSet>> entry_inputs;
+        int group_number = 0;
+        for (auto group : groups) {
+            tc::Address group_address = (groups.size() == 1)
+                                            ? ss_address
+                                            : tc::Address(ss_address, std::to_string(group_number));
+            group_number++;
+            suffstat_elements[group_address.to_string()] =
+                element_of(tc::Address(group.second.front()));
+            size_t entry = 0;
+            for (auto e : group.second) {
+                tc::PortAddress values("values", group_address);
+                group_inputs[group_address].insert(e);
+                entries_of[e].push_back({group_address, entry});
+                entry_inputs.push_back({{group_address, entry++}, {e}});
+                switch (type) {
+                    case compoGM::gamma_sr:
+                    case compoGM::gamma_ss:
+                        model.connect<Use<Value<double>>>(values, tc::Address(gm, tc::Address(e)));
+                        break;
+                    case compoGM::poisson:
+                        model.connect<Use<Value<int>>>(values, tc::Address(gm, tc::Address(e)));
+                        break;
+                    case compoGM::normal: {
+                        auto mean = index.port_parents_of(e).at("a");
+                        model.connect<Use<Value<double>>>(values, tc::Address(gm, tc::Address(e)));
+                        model.connect<Use<Value<double>>>(tc::PortAddress("means", group_address),
+                            tc::Address(gm, tc::Address(mean)));
+                        groups_of_parent[mean][group_address].insert("a");
+                        group_inputs[group_address].insert(mean);
+                        entries_of[mean].push_back(entry_inputs.back().first);
+                        auto mean_inputs = upstream(mean, index);
+                        entry_inputs.back().second.insert(mean_inputs.begin(), mean_inputs.end());
+                        break;
+                    }
+                }
+            }
+            for (auto p : group.first) {
+                model.connect<Use<Value<double>>>(tc::PortAddress(p.first, group_address),
+                    tc::Address(gm, tc::Address(p.second)));
+                groups_of_parent[p.second][group_address].insert(p.first);
+                group_inputs[group_address].insert(p.second);
+            }
+        }
+
+        // moves notify the entries their target feeds into; entries are watched when all the nodes
+        // they depend on that can change (i.e., that have a backup) are targets of moves
+        // (moves that may run on a frozen program do not notify, see freeze)
+        NameSet move_targets;
+        for (auto& m : moves) {
+            if (freeze_model and freezable(m)) { continue; }
+            for (auto im : individual_moves(m.target)) {
+                std::set<std::pair<tc::Address, size_t>> notified;  // (suffstat, entry)
+                for (auto target : nodes_of(im.second)) {
+                    move_targets.insert(target);
+                    for (auto node : downstream(target, index)) {
+                        auto it = entries_of.find(node);
+                        if (it == entries_of.end()) { continue; }
+                        notified.insert(it->second.begin(), it->second.end());
+                        notifying_targets.insert(m.target);
+                    }
+                }
+                for (auto& e : notified) {
+                    model.connect<NotifyChanges>(
+                        tc::PortAddress("changes", im.first), e.first, e.second);
+                }
+            }
+        }
+        for (auto& e : entry_inputs) {
+            bool watched = std::all_of(e.second.begin(), e.second.end(), [&](const NodeName& n) {
+                return move_targets.count(n) > 0 or
+                       !model.has_type<Backup>(tc::Address(gm, tc::Address(n)));
+            });
+            if (watched) {
+                model.connect<tc::Set<size_t>>(
+                    tc::PortAddress("watched", e.first.first), e.first.second);
+            }
         }
+
+        // element moves use the suffstats whose parents depend on their target
         for (auto am : affected_moves) {
-            tc::Address move_address(am.to_string("-") + "_move");
-            model.connect<DirectedLogProb>(
-                tc::PortAddress("logprob", move_address), ss_address, LogProbSelector::Full);
+            for (auto m : individual_moves(am)) {
+                std::map<tc::Address, std::set<std::string>> used_groups;  // group -> ports
+                for (auto target : nodes_of(m.second)) {
+                    for (auto node : downstream(target, index)) {
+                        auto it = groups_of_parent.find(node);
+                        if (it != groups_of_parent.end()) {
+                            for (auto group : it->second) {
+                                used_groups[group.first].insert(
+                                    group.second.begin(), group.second.end());
+                            }
+                        }
+                    }
+                }
+                for (auto group : used_groups) {
+                    model.connect<DirectedLogProb>(tc::PortAddress("logprob", m.first),
+                        group.first, direction_of(group.second));
+                    auto& inputs = group_inputs.at(group.first);
+                    suffstat_reads[m.second.to_string()].insert(inputs.begin(), inputs.end());
+                }
+            }
         }
     }
 
     void declare_move(tc::Address target, compoGM::MoveType move_type, compoGM::DataType data_type,
-        int, double) const {
+        std::function<void(const MCMC&, tc::Address, tc::Address)> create,
+        const GMIndex& index) const {
         compoGM::p.message("Adding move on %s in model %s", target.c_str(), gm.c_str());
         tc::Address target_glob(gm, target);
         tc::Address move_address(target.to_string("-") + "_move");
@@ -155,29 +431,275 @@ class MCMC {
         }
 
         switch (move_type) {
-            case compoGM::scale: adaptive_create<Scale>(move_address, target_glob); break;
-            case compoGM::shift: adaptive_create<Shift>(move_address, target_glob); break;
+            case compoGM::scale:
+                adaptive_create<SimpleMHMove<Scale>>(move_address, target_glob);
+                break;
+            case compoGM::shift:
+                adaptive_create<SimpleMHMove<Shift>>(move_address, target_glob);
+                break;
+            case compoGM::gibbs: declare_gibbs(mp, target, used_ss, index); return;
+            case compoGM::custom: create(*this, move_address, target_glob); break;
         }
         switch (data_type) {
             case compoGM::integer:
-                model.connect<ConnectMove<int>>(mp, gm, target_glob, used_ss);
+                model.connect<ConnectMove<int>>(mp, gm, target_glob, used_ss, &index);
                 break;
             case compoGM::fp:
-                model.connect<ConnectMove<double>>(mp, gm, target_glob, used_ss);
+                model.connect<ConnectMove<double>>(mp, gm, target_glob, used_ss, &index);
                 break;
         }
     }
 
-    void declare_moves() const {
+    // suffstat type matching the nodes of a composite of the graphical model (false if none)
+    bool suffstat_type_of(NodeName composite, compoGM::SuffstatType& type) const {
+        tc::Address a(gm, tc::Address(composite));
+        if (is_binary_node_of<GammaShapeScaleDistribution>(a, model)) {
+            type = compoGM::gamma_ss;
+        } else if (is_binary_node_of<GammaShapeRateDistribution>(a, model)) {
+            type = compoGM::gamma_sr;
+        } else if (is_unary_node_of<PoissonDistribution>(a, model)) {
+            type = compoGM::poisson;
+        } else if (is_binary_node_of<NormalDistribution>(a, model)) {
+            type = compoGM::normal;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Adds suffstats for moves on single nodes (typically hyperparameters) whose blanket contains
+    // elements of an array or matrix of Gamma, Poisson or Normal nodes, provided these elements
+    // share their parents (except means for Normal nodes) so that suffstats actually factor terms.
+    void add_detected_suffstats(const GMIndex& index) {
+        std::set<NodeName> declared;
+        for (auto ss : suffstats) { declared.insert(ss.target.to_string()); }
+
+        std::map<NodeName, std::set<tc::Address>> found;  // composite -> moves
         for (auto m : moves) {
-            declare_move(m.target, m.move_type, m.data_type, m.move_rep, m.tuning_mult);
+            bool single = !model.is_composite(tc::Address(gm, m.target));
+            if (m.move_type == compoGM::gibbs or !single or ss_usage.count(m.target) > 0) {
+                continue;
+            }
+            for (auto& node : index.blanket(m.target.to_string())) {
+                auto composite = first_part(node.first);
+                if (declared.count(composite) == 0 and
+                    model.is_composite(tc::Address(gm, tc::Address(composite)))) {
+                    found[composite].insert(m.target);
+                }
+            }
         }
-        for (auto s : suffstats) { declare_suffstat(s.target, s.affected_moves, s.type); }
+
+        for (auto f : found) {
+            compoGM::SuffstatType type;
+            if (!suffstat_type_of(f.first, type)) { continue; }
+            std::set<std::map<std::string, NodeName>> groups;
+            tc::Address composite(gm, tc::Address(f.first));
+            auto elements = model.get_composite(composite).all_addresses();
+            for (auto e : elements) {
+                auto key = index.port_parents_of(tc::Address(tc::Address(f.first), e).to_string());
+                if (type == compoGM::normal) { key.erase("a"); }
+                groups.insert(key);
+            }
+            if (2 * groups.size() > elements.size()) { continue; }  // not enough sharing
+
+            std::stringstream ss;
+            for (auto m : f.second) { ss << m << " "; }
+            compoGM::p.message("Automatically adding suffstat on %s for moves on %s",
+                f.first.c_str(), ss.str().c_str());
+            suffstat(f.first, f.second, type);
+        }
+    }
+
+    // opt-out of automatic suffstat detection (see add_detected_suffstats)
+    void auto_suffstats(bool enabled) { detect_suffstats = enabled; }
+
+    // the graphical model is indexed once and the index is shared by all move declarations
+    void declare_moves() {
+        compoGM::p.message("Indexing graphical model %s", gm.c_str());
+        GMIndex index(model.get_composite(gm));
+        if (detect_suffstats) { add_detected_suffstats(index); }
+        for (auto m : moves) {
+            declare_move(m.target, m.move_type, m.data_type, m.create, index);
+        }
+        for (auto s : suffstats) { declare_suffstat(s.target, s.affected_moves, s.type, index); }
+    }
+
+    // (move, target) pairs of all individual moves on target (mirrors ConnectMove)
+    std::vector<std::pair<tc::Address, tc::Address>> individual_moves(tc::Address target) const {
+        tc::Address move_address(target.to_string("-") + "_move");
+        std::vector<tc::Address> element_addresses;
+        if (is_matrix(move_address, model)) {
+            element_addresses = model.get_composite(tc::Address(gm, target)).all_addresses();
+        } else if (is_array(move_address, model)) {
+            element_addresses = model.get_composite(move_address).all_addresses();
+        } else {
+            return {{move_address, target}};
+        }
+        std::vector<std::pair<tc::Address, tc::Address>> result;
+        for (auto e : element_addresses) {
+            result.push_back({tc::Address(move_address, e), tc::Address(target, e)});
+        }
+        return result;
+    }
+
+    // nodes changed by an individual move on target: the cells of target when the move updates a
+    // whole dense array or matrix row (see DenseGibbsMove), target itself otherwise
+    std::vector<NodeName> nodes_of(const tc::Address& target) const {
+        tc::Address target_glob(gm, target);
+        if (!model.is_composite(target_glob)) { return {target.to_string()}; }
+        std::vector<NodeName> result;
+        for (auto e : model.get_composite(target_glob).all_addresses()) {
+            result.push_back(tc::Address(target, e).to_string());
+        }
+        return result;
+    }
+
+    // what an individual move on target reads and writes, including the suffstats it reads
+    MoveFootprint footprint(const tc::Address& target, const GMIndex& index) const {
+        MoveFootprint result;
+        for (auto node : nodes_of(target)) {
+            auto node_footprint = move_footprint(node, index);
+            result.read.insert(node_footprint.read.begin(), node_footprint.read.end());
+            result.written.insert(node_footprint.written.begin(), node_footprint.written.end());
+        }
+        auto extra = suffstat_reads.find(target.to_string());
+        if (extra != suffstat_reads.end()) {
+            result.read.insert(extra->second.begin(), extra->second.end());
+        }
+        return result;
+    }
+
+    // colors the moves on targets into independent sets; moves are always performed in this order
+    // (even on one thread) so that results do not depend on the number of threads
+    // (move_at gives the move object to use for a move address)
+    Sweep make_sweep(std::function<Move*(const tc::Address&)> move_at,
+        const std::vector<tc::Address>& targets, const GMIndex& index) const {
+        std::vector<Move*> pointers;
+        std::vector<MoveFootprint> footprints;
+        for (auto target : targets) {
+            for (auto m : individual_moves(target)) {
+                pointers.push_back(move_at(m.first));
+                footprints.push_back(footprint(m.second, index));
+            }
+        }
+
+        auto colors = color_moves(footprints);
+        Sweep result;
+        for (size_t i = 0; i < pointers.size(); i++) {
+            if (colors.at(i) >= int(result.size())) { result.resize(colors.at(i) + 1); }
+            result.at(colors.at(i)).push_back(pointers.at(i));
+        }
+        return result;
+    }
+
+    // one move step at a given iteration: either the fixed tuning triple or an adaptive move (moves
+    // that do not depend on tuning are performed once)
+    void perform_move(Move* move, int iteration) const {
+        if (!move->tunable()) {
+            move->move();
+        } else if (burn_in < 0) {
+            move->move(1.0);
+            move->move(0.1);
+            move->move(0.01);
+        } else {
+            move->adaptive_move(iteration < burn_in);
+        }
+    }
+
+    void perform(const Sweep& sweep, ThreadPool& pool, int iteration) const {
+        for (auto& moves : sweep) {
+            pool.parallel_for(moves.size(),
+                [this, &moves, iteration](size_t i) { perform_move(moves[i], iteration); });
+        }
+    }
+
+    // number of threads used to perform independent moves in parallel
+    void threads(int nb) { nb_threads = nb; }
+
+    // moves are performed once per step with a proposal width adapted during the first burn_in
+    // iterations (instead of three times with tunings 1, 0.1 and 0.01)
+    void adaptive(int nb_burn_in_iterations) { burn_in = nb_burn_in_iterations; }
+
+    // all random streams of the chain derive from seed; chains with the same seed are independent
+    void seed(uint64_t new_seed, uint64_t new_chain = 0) {
+        random_seed = new_seed;
+        chain = new_chain;
+        set_global_seed(new_seed);
+    }
+
+    // gives each move its own stream, identified by the move address
+    void seed_moves(tc::Assembly& a) const {
+        compoGM::p.message("Seeding moves with seed %llu (chain %llu)",
+            (unsigned long long)random_seed, (unsigned long long)chain);
+        auto all_moves = a.get_all<Move>();
+        auto names = all_moves.names();
+        auto pointers = all_moves.pointers();
+        for (size_t i = 0; i < pointers.size(); i++) {
+            pointers.at(i)->seed(chain_key(random_seed, chain), stream_of(names.at(i).to_string()));
+        }
+    }
+
+    // scale and shift moves that do not use suffstats can run on a frozen program
+    bool freezable(const compoGM::_MoveDecl& m) const {
+        return (m.move_type == compoGM::scale or m.move_type == compoGM::shift) and
+               m.data_type == compoGM::fp and ss_usage.count(m.target) == 0;
+    }
+
+    // moves on the frozen program replace freezable component moves that do not notify suffstats
+    // (other moves keep running on components); returns the targets of frozen moves
+    std::set<tc::Address> freeze_moves(
+        FrozenProgram& program, std::map<tc::Address, std::unique_ptr<Move>>& frozen_moves) const {
+        std::set<tc::Address> result;
+        for (auto m : moves) {
+            bool frozen = freezable(m) and notifying_targets.count(m.target) == 0;
+            for (auto im : individual_moves(m.target)) {
+                auto target = im.second.to_string();
+                if (!frozen) {
+                    for (auto node : nodes_of(im.second)) { program.watch(node); }
+                    continue;
+                }
+                if (m.move_type == compoGM::scale) {
+                    frozen_moves[im.first].reset(new FrozenMHMove<Scale>(program, target));
+                } else {
+                    frozen_moves[im.first].reset(new FrozenMHMove<Shift>(program, target));
+                }
+                frozen_moves[im.first]->seed(
+                    chain_key(random_seed, chain), stream_of(im.first.to_string()));
+                program.publish(target);
+            }
+            if (frozen) { result.insert(m.target); }
+        }
+        return result;
+    }
+
+    // lowers the graphical model into a flat program after assembly (see frozen.hpp); models that
+    // cannot be lowered fall back to moves on components
+    // when called before declare_moves, moves changing nodes that suffstats depend on can be
+    // frozen too: they do not notify suffstats, which then check these nodes through versions
+    void freeze(bool enabled = true) { freeze_model = enabled; }
+
+    // allocate components in an arena (optionally backed by huge pages), placing components of
+    // the same array element (e.g., gene) next to each other
+    void arena(bool enabled = true, bool with_huge_pages = false) {
+        use_arena = enabled;
+        huge_pages = with_huge_pages;
     }
 
     void go(int nb_iterations, int nb_rep, std::set<tc::Address> to_trace = {}) const {
         compoGM::p.message("Instantiating component assembly");
-        tc::Assembly a(model);
+        Arena component_arena(huge_pages);  // must outlive the assembly
+        std::unique_ptr<tc::Assembly> assembly;
+        if (use_arena) {
+            // key is the element (e.g., gene) of components in arrays of the graphical model, and
+            // of the moves, sibling groups and suffstats on them
+            assembly = arena_assembly(model, component_arena,
+                [this](const tc::Address& address) { return element_key(address); });
+            component_arena.report();
+        } else {
+            assembly.reset(new tc::Assembly(model));
+        }
+        tc::Assembly& a = *assembly;
+        seed_moves(a);
 
         compoGM::p.message("Setting up trace");
 
@@ -187,60 +709,114 @@ class MCMC {
             a.get_all<Value<double>>((to_trace.size() == 0) ? all_moved : to_trace), "tmp.dat");
         trace.header();
 
-        // set of all moves, used to determine which ones are not covered by suffstats
-        std::set<tc::Address> all_moves;
-        for (auto m : moves) { all_moves.insert(tc::Address(m.target.to_string("-") + "_move")); }
+        // targets of all moves, used to determine which ones are not covered by suffstats
+        std::set<tc::Address> other_targets;
+        for (auto m : moves) { other_targets.insert(m.target); }
+
+        compoGM::p.message("Analyzing graphical model to find independent moves");
+        GMIndex index(model.get_composite(gm));
+        auto component_move = [&a](const tc::Address& m) { return &a.at<Move>(m); };
+
+        std::unique_ptr<FrozenProgram> program;
+        std::map<tc::Address, std::unique_ptr<Move>> frozen_moves;
+        std::set<tc::Address> frozen_targets;
+        if (freeze_model) {
+            compoGM::p.message("Freezing graphical model %s", gm.c_str());
+            program.reset(new FrozenProgram(a, model, gm, index));
+            if (program->supported()) {
+                frozen_targets = freeze_moves(*program, frozen_moves);
+                compoGM::p.message("Frozen program has %d nodes and runs %d moves",
+                    int(program->size()), int(frozen_moves.size()));
+            } else {
+                compoGM::p.message("Graphical model cannot be frozen (%s), using components",
+                    program->get_error().c_str());
+                program.reset();
+            }
+        }
+        for (auto t : frozen_targets) { other_targets.erase(t); }
 
         // debug
         std::stringstream schedule;
 
         compoGM::p.message("Gathering pointers to moves and suff stats");
-        std::map<tc::Address, std::pair<Proxy*, std::vector<Move*>>> pointersets;
+        std::map<tc::Address, std::pair<std::vector<Proxy*>, Sweep>> pointersets;
         for (auto ss : suffstats) {
             schedule << "\t* gather suff stats for " << ss.target
                      << "\n\t* perfom the following moves " << nb_rep << " times: ";
-            pointersets[ss.target].first = &a.at<Proxy>(ss.target.to_string("-") + "_suffstats");
+            std::vector<tc::Address> targets;
             for (auto m : ss.affected_moves) {
-                tc::Address move_address(m.to_string("-") + "_move");
-                schedule << move_address << " ";
-
-                all_moves.erase(move_address);
-                auto ptrs = a.get_all<Move>(std::set<tc::Address>{move_address}).pointers();
-                auto& entry = pointersets.at(ss.target).second;
-                entry.insert(entry.end(), ptrs.begin(), ptrs.end());
+                schedule << tc::Address(m.to_string("-") + "_move") << " ";
+                other_targets.erase(m);
+                targets.push_back(m);
             }
-            schedule << "\n\t* release suff stats for " << ss.target << "\n";
+            tc::Address ss_address(ss.target.to_string("-") + "_suffstats");
+            auto proxies = a.get_all<Proxy>(std::set<tc::Address>{ss_address}).pointers();
+            pointersets[ss.target] = {proxies, make_sweep(component_move, targets, index)};
+            schedule << "in " << pointersets.at(ss.target).second.size() << " independent sets"
+                     << "\n\t* release suff stats for " << ss.target << "\n";
         }
-        auto other_moves = a.get_all<Move>(all_moves).pointers();
+        auto other_moves = make_sweep(component_move,
+            std::vector<tc::Address>(other_targets.begin(), other_targets.end()), index);
         schedule << "\t* perfom the following moves: ";
-        for (auto m : all_moves) { schedule << m << " "; }
+        for (auto m : other_targets) { schedule << tc::Address(m.to_string("-") + "_move") << " "; }
+        schedule << "in " << other_moves.size() << " independent sets";
+        auto frozen_sweep = make_sweep(
+            [&frozen_moves](const tc::Address& m) { return frozen_moves.at(m).get(); },
+            std::vector<tc::Address>(frozen_targets.begin(), frozen_targets.end()), index);
+        if (program) {
+            schedule << "\n\t* perform the following moves on the frozen program: ";
+            for (auto m : frozen_targets) {
+                schedule << tc::Address(m.to_string("-") + "_move") << " ";
+            }
+            schedule << "in " << frozen_sweep.size() << " independent sets";
+        }
         compoGM::p.message("Move schedule is:\n%s", schedule.str().c_str());
 
-        compoGM::p.message("Starting MCMC chain for %d iterations", nb_iterations);
+        TLBMissCounter tlb_misses;  // created before the pool so that workers are counted
+        ThreadPool pool(nb_threads);
+        compoGM::p.message(
+            "Starting MCMC chain for %d iterations on %d threads", nb_iterations, nb_threads);
         Chrono total_time;
         for (int iteration = 0; iteration < nb_iterations; iteration++) {
-            for (auto ps : pointersets) {
-                ps.second.first->acquire();
+            for (auto& ps : pointersets) {
+                for (auto proxy : ps.second.first) { proxy->acquire(); }
                 for (int rep = 0; rep < nb_rep; rep++) {
-                    for (auto m : ps.second.second) {
-                        m->move(1.0);
-                        m->move(0.1);
-                        m->move(0.01);
-                    }
+                    perform(ps.second.second, pool, iteration);
                 }
-                ps.second.first->release();
+                for (auto proxy : ps.second.first) { proxy->release(); }
             }
-            for (int rep = 0; rep < nb_rep; rep++) {
-                for (auto m : other_moves) {
-                    m->move(1.0);
-                    m->move(0.1);
-                    m->move(0.01);
-                }
+            for (int rep = 0; rep < nb_rep; rep++) { perform(other_moves, pool, iteration); }
+            if (program) {
+                program->pull();
+                for (int rep = 0; rep < nb_rep; rep++) { perform(frozen_sweep, pool, iteration); }
+                program->push();
             }
             trace.line();
+            if (iteration == 0 and tlb_misses.available()) {
+                compoGM::p.message("dTLB misses during first iteration: %lld", tlb_misses.count());
+            }
+            if (iteration + 1 == burn_in) {
+                compoGM::p.message("End of burn-in, move tunings are now frozen");
+            }
         }
         double elapsed_time = total_time.end();
         compoGM::p.message("MCMC chain has finished in %fms (%fms/iteration)", elapsed_time,
             elapsed_time / nb_iterations);
+        if (tlb_misses.available()) {
+            compoGM::p.message("dTLB misses during chain: %lld", tlb_misses.count());
+        }
+        for (auto t : frozen_targets) {  // frozen moves are not components, so they report here
+            double sum_rates = 0;
+            auto elements = individual_moves(t);
+            for (auto m : elements) {
+                auto move = frozen_moves.at(m.first).get();
+                auto scale_move = dynamic_cast<FrozenMHMove<Scale>*>(move);
+                sum_rates += (scale_move != nullptr)
+                                 ? scale_move->accept_rate()
+                                 : dynamic_cast<FrozenMHMove<Shift>*>(move)->accept_rate();
+            }
+            compoGM::p.message("Frozen moves on %s: mean acceptance rate %f", t.c_str(),
+                sum_rates / elements.size());
+        }
     }
-};
\ No newline at end of file
+};
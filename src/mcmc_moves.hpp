@@ -28,16 +28,52 @@ license and that you accept its terms.*/
 #pragma once
 
 #include <tinycompo.hpp>
+#include "arena.hpp"
+#include "dense_arrays.hpp"
 #include "interfaces.hpp"
+#include "suffstats.hpp"
 #include "utils.hpp"
 
+/*
+====================================================================================================
+  ~*~ AdaptiveTuning ~*~
+  Proposal width of a MH move adapted toward a target acceptance rate (Robbins-Monro on the log
+  width with decreasing steps, clamped to avoid degenerate widths).
+==================================================================================================*/
+class AdaptiveTuning {
+    static constexpr double target_acceptance = 0.44;  // optimal for one-dimensional proposals
+    double log_tuning{0};
+    int nb_adaptations{0};
+
+  public:
+    double get() const { return exp(log_tuning); }
+
+    void update(bool accept) {
+        nb_adaptations++;
+        double step = pow(nb_adaptations, -0.6);
+        log_tuning += step * ((accept ? 1.0 : 0.0) - target_acceptance);
+        log_tuning = std::max(-20.0, std::min(5.0, log_tuning));
+    }
+
+    // appends the state to a move state / reads it back, returns the number of values read
+    void save(std::vector<double>& state) const {
+        state.push_back(log_tuning);
+        state.push_back(nb_adaptations);
+    }
+    size_t load(const double* state) {
+        log_tuning = state[0];
+        nb_adaptations = int(state[1]);
+        return 2;
+    }
+};
+
 /*
 ====================================================================================================
   ~*~ SimpleMHMove ~*~
   A generic Metropolis-Hastings move.
 ==================================================================================================*/
 template <class M>
-class SimpleMHMove : public Move, public tc::Component {
+class SimpleMHMove : public Move, public tc::Component, public ArenaAllocated {
     using ValueType = typename M::ValueType;
 
     // config
@@ -45,31 +81,220 @@ class SimpleMHMove : public Move, public tc::Component {
     Backup* target_backup;
     std::vector<LogProbSelector> log_probs;
     void add_log_prob(LogProbSelector selector) { log_probs.push_back(selector); }
+    ChangeSubscribers subscribers;  // notified every time the target changes
+    void add_subscription(ChangeSubscription s) { subscribers.add(s); }
+
+    // log prob of the blanket for the current value of the target; it remains valid as long as the
+    // blanket version does not change (i.e., no node or parent in the blanket has changed)
+    double cached_log_prob{0};
+    size_t cached_version{0};
+    bool cache_valid{false};
+
+    double blanket_log_prob() {
+        return accumulate(log_probs.begin(), log_probs.end(), 0.0,
+            [](double acc, LogProbSelector& s) { return acc + s.get_log_prob(); });
+    }
+
+    size_t blanket_version() const {
+        return accumulate(log_probs.begin(), log_probs.end(), size_t(0),
+            [](size_t acc, const LogProbSelector& s) { return acc + s.get_log_prob_version(); });
+    }
+
+    RandomStream rng;
+
+    AdaptiveTuning adaptive_tuning;  // proposal width used by adaptive_move
 
     // internal stats
     int reject{0}, total{0};
 
+    bool mh_step(double tuning) {
+        bool cache_hit = cache_valid and blanket_version() == cached_version;
+        double log_prob_before = cache_hit ? cached_log_prob : blanket_log_prob();
+        target_backup->backup();  // right before changing value (see Backup interface)
+        double log_hastings = M::move(target->get_ref(), tuning, rng);
+        subscribers.notify();
+        double log_prob_after = blanket_log_prob();
+        bool accept = rng.decide(exp(log_prob_after - log_prob_before + log_hastings));
+        if (not accept) {
+            target_backup->restore();
+            subscribers.notify();
+            reject++;
+        }
+        cached_log_prob = accept ? log_prob_after : log_prob_before;
+        cached_version = blanket_version();
+        cache_valid = true;
+        total++;
+        return accept;
+    }
+
   public:
     SimpleMHMove() {
         port("target", &SimpleMHMove::target);
         port("targetbackup", &SimpleMHMove::target_backup);
         port("logprob", &SimpleMHMove::add_log_prob);
+        port("changes", &SimpleMHMove::add_subscription);
     }
 
-    void move(double tuning = 1.0) final {
-        target_backup->backup();
-        double log_prob_before = accumulate(log_probs.begin(), log_probs.end(), 0.0,
-            [](double acc, LogProbSelector s) { return acc + s.get_log_prob(); });
-        double log_hastings = M::move(target->get_ref(), tuning);
-        double log_prob_after = accumulate(log_probs.begin(), log_probs.end(), 0.0,
-            [](double acc, LogProbSelector s) { return acc + s.get_log_prob(); });
-        bool accept = decide(exp(log_prob_after - log_prob_before + log_hastings));
-        if (not accept) {
-            target_backup->restore();
-            reject++;
-        }
-        total++;
+    void move(double tuning = 1.0) final { mh_step(tuning); }
+
+    bool tunable() const final { return true; }
+
+    void adaptive_move(bool adapt) final {
+        bool accept = mh_step(adaptive_tuning.get());
+        if (adapt) { adaptive_tuning.update(accept); }
+    }
+
+    void seed(uint64_t key, uint64_t stream) final { rng.reset(key, stream); }
+
+    std::vector<double> get_state() const final {
+        std::vector<double> state{double(rng.tell()), double(reject), double(total)};
+        adaptive_tuning.save(state);
+        return state;
+    }
+
+    void set_state(const std::vector<double>& state) final {
+        rng.seek(uint64_t(state.at(0)));
+        reject = int(state.at(1));
+        total = int(state.at(2));
+        adaptive_tuning.load(&state.at(3));
+        cache_valid = false;
     }
 
     double accept_rate() const { return double(total - reject) / total; }
+
+    double tuning() const { return adaptive_tuning.get(); }
+};
+
+/*
+====================================================================================================
+  ~*~ GibbsMove ~*~
+  Draws the target directly from its full conditional (see conjugate updates in suffstats.hpp).
+  Prior parameters and children are connected by ConnectIndividualGibbs.
+==================================================================================================*/
+template <class Conjugacy>
+class GibbsMove : public Move, public tc::Component, public ArenaAllocated {
+    Value<double>* target;
+    Backup* target_backup;
+    Value<double>* prior_a;
+    Value<double>* prior_b;
+    std::vector<typename Conjugacy::Child> children;
+    void add_child(typename Conjugacy::Child child) { children.push_back(child); }
+    ChangeSubscribers subscribers;  // notified every time the target changes
+    void add_subscription(ChangeSubscription s) { subscribers.add(s); }
+
+    RandomStream rng;
+
+  public:
+    GibbsMove() {
+        port("target", &GibbsMove::target);
+        port("targetbackup", &GibbsMove::target_backup);
+        port("prior_a", &GibbsMove::prior_a);
+        port("prior_b", &GibbsMove::prior_b);
+        port("child", &GibbsMove::add_child);
+        port("changes", &GibbsMove::add_subscription);
+    }
+
+    void move(double = 1.0) final {
+        double new_value = Conjugacy::draw(target->get_ref(), prior_a->get_ref(),
+            prior_b->get_ref(), children.data(), children.data() + children.size(), rng);
+        target_backup->backup();  // right before changing value (see Backup interface)
+        target->get_ref() = new_value;
+        subscribers.notify();
+    }
+
+    void adaptive_move(bool) final { move(); }
+
+    bool tunable() const final { return false; }
+
+    void seed(uint64_t key, uint64_t stream) final { rng.reset(key, stream); }
+
+    std::vector<double> get_state() const final { return {double(rng.tell())}; }
+
+    void set_state(const std::vector<double>& state) final { rng.seek(uint64_t(state.at(0))); }
+};
+
+/*
+====================================================================================================
+  ~*~ DenseGibbsMove ~*~
+  Gibbs updates of all the cells of a dense array, or of a row of a dense matrix, in one move. Cells
+  are drawn one after the other from the storage (priors are the parents of each cell), and suffstat
+  entries are notified once per move. Cells and children are connected by ConnectDenseGibbs.
+==================================================================================================*/
+template <class Conjugacy, class PDS>
+class DenseGibbsMove : public Move, public tc::Component, public ArenaAllocated {
+    using Child = typename Conjugacy::Child;
+    using Storage = DenseStorage<PDS>;
+
+    Storage* storage{nullptr};
+    std::vector<size_t> positions;  // of the targets in storage
+    std::vector<DenseConjugateChild<Child>> cell_children;
+    void add_target(DenseCell<PDS>* cell) {
+        if (storage != nullptr and storage != &cell->dense_storage()) {
+            compoGM::p.fail("DenseGibbsMove: all targets must belong to the same dense array");
+        }
+        storage = &cell->dense_storage();
+        positions.push_back(cell->position());
+        prepared = false;
+    }
+    void add_child(DenseConjugateChild<Child> child) {
+        cell_children.push_back(child);
+        prepared = false;
+    }
+    ChangeSubscribers subscribers;  // notified once after all targets have changed
+    void add_subscription(ChangeSubscription s) { subscribers.add(s); }
+
+    // children of target k are children[offsets[k]..offsets[k+1])
+    bool prepared{false};
+    std::vector<Child> children;
+    std::vector<size_t> offsets;
+    void prepare() {
+        std::sort(positions.begin(), positions.end());
+        std::stable_sort(cell_children.begin(), cell_children.end(),
+            [](const DenseConjugateChild<Child>& c1, const DenseConjugateChild<Child>& c2) {
+                return c1.position < c2.position;
+            });
+        children.clear();
+        offsets.assign(1, 0);
+        auto c = cell_children.begin();
+        for (auto i : positions) {
+            for (; c != cell_children.end() and c->position == i; c++) {
+                children.push_back(c->child);
+            }
+            offsets.push_back(children.size());
+        }
+        prepared = true;
+    }
+
+    RandomStream rng;
+
+  public:
+    DenseGibbsMove() {
+        port("target", &DenseGibbsMove::add_target);
+        port("child", &DenseGibbsMove::add_child);
+        port("changes", &DenseGibbsMove::add_subscription);
+    }
+
+    void move(double = 1.0) final {
+        if (!prepared) { prepare(); }
+        auto& s = *storage;
+        for (size_t k = 0; k < positions.size(); k++) {
+            auto i = positions[k];
+            double new_value = Conjugacy::draw(s.values[i], s.a[i]->get_ref(), s.b[i]->get_ref(),
+                children.data() + offsets[k], children.data() + offsets[k + 1], rng);
+            s.bk_values[i] = s.values[i];  // see DenseCell::backup
+            s.versions[i]++;
+            s.values[i] = new_value;
+        }
+        subscribers.notify();
+    }
+
+    void adaptive_move(bool) final { move(); }
+
+    bool tunable() const final { return false; }
+
+    void seed(uint64_t key, uint64_t stream) final { rng.reset(key, stream); }
+
+    std::vector<double> get_state() const final { return {double(rng.tell())}; }
+
+    void set_state(const std::vector<double>& state) final { rng.seek(uint64_t(state.at(0))); }
 };
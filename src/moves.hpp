@@ -36,8 +36,8 @@ license and that you accept its terms.*/
 struct Scale {
     using ValueType = double;
 
-    static double move(double& value, double tuning = 1.0) {
-        auto multiplier = tuning * (uniform(generator) - 0.5);
+    static double move(double& value, double tuning, RandomStream& rng) {
+        auto multiplier = tuning * (rng.uniform() - 0.5);
         value *= exp(multiplier);
         return multiplier;
     }
@@ -50,8 +50,8 @@ struct Scale {
 struct Shift {
     using ValueType = double;
 
-    static double move(double& value, double tuning = 1.0) {
-        auto shift = tuning * (uniform(generator) - 0.5);
+    static double move(double& value, double tuning, RandomStream& rng) {
+        auto shift = tuning * (rng.uniform() - 0.5);
         value += shift;
         return 0;
     }
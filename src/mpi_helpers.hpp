@@ -38,6 +38,7 @@ void mpi_run(int argc, char** argv, F f) {
     compoGM::p.message("Started MPI process");
     f(argc, argv);
     compoGM::p.message("End of MPI process");
+    mpi_topology.release();
     MPI_Finalize();
 }
 
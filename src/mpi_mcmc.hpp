@@ -27,12 +27,270 @@ license and that you accept its terms.*/
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <numeric>
 #include "mcmc.hpp"
 #include "mpi_helpers.hpp"
+#include "mpi_moves.hpp"
 
 class MpiMCMC : public MCMC {
+    // calibration (see measure_costs)
+    std::unique_ptr<Partition> cost_partition;
+    std::string cost_file;
+
+    // time spent in moves of each element of cost_partition on workers, written by master
+    void write_costs(const std::vector<tc::Address>& move_names,
+        const std::vector<double>& move_costs, int nb_iterations) const {
+        auto& partition = *cost_partition;
+        auto in_partition = [&partition](int rank) {
+            return rank >= int(partition.offset()) and
+                   rank < int(partition.offset() + partition.size());
+        };
+        if (compoGM::p.rank) {
+            std::map<std::string, double> element_costs;  // moves are arrays indexed by element
+            for (size_t i = 0; i < move_names.size(); i++) {
+                element_costs[element_of(move_names[i])] += move_costs[i] / nb_iterations;
+            }
+            std::vector<double> data;
+            if (in_partition(compoGM::p.rank)) {
+                auto indexes = partition.my_partition();
+                for (auto index : indexes) { data.push_back(element_costs[indexes.name(index)]); }
+            }
+            MPI_Gatherv(data.data(), data.size(), MPI_DOUBLE, NULL, NULL, NULL, MPI_DOUBLE, 0,
+                MPI_COMM_WORLD);
+        } else {
+            std::vector<int> displs{0}, revcounts{0};
+            int displ = 0;
+            for (int rank = 1; rank < compoGM::p.size; rank++) {
+                int count = in_partition(rank) ? partition.partition_size(rank) : 0;
+                revcounts.push_back(count);
+                displs.push_back(displ);
+                displ += count;
+            }
+            std::vector<double> data(displ, 0);
+            MPI_Gatherv(NULL, 0, MPI_DOUBLE, data.data(), revcounts.data(), displs.data(),
+                MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+            std::ofstream file(cost_file);
+            file << "index\tcost\n";
+            for (int rank = 1; rank < compoGM::p.size; rank++) {
+                if (!in_partition(rank)) { continue; }
+                auto indexes = partition.get_partition(rank);
+                for (size_t i = 0; i < indexes.size(); i++) {
+                    file << indexes.name(indexes[i]) << "\t" << data.at(displs[rank] + i) << "\n";
+                }
+            }
+            compoGM::p.message("Wrote costs of %d indexes (ms/iteration) to %s", displ,
+                cost_file.c_str());
+        }
+    }
+
+    // migration (see migrate)
+    std::unique_ptr<Partition> migration_partition;
+    int migration_period{0};
+    double migration_threshold{1};
+    static constexpr int migration_tag = 32767;
+
+    // worker components attached to each index of the migration partition
+    struct Migratable {
+        std::vector<std::vector<Value<double>*>> nodes;  // by index id, stochastic nodes only
+        std::vector<std::vector<size_t>> moves;           // by index id, positions in move list
+        std::vector<size_t> other_moves;                  // moves not on an index
+    };
+
+    Migratable find_migratable(const tc::Assembly& a, const std::vector<tc::Address>& move_names,
+        const Partition& partition) const {
+        auto& dict = *partition.indexes().dictionary();
+        Migratable result;
+        result.nodes.resize(dict.size());
+        result.moves.resize(dict.size());
+        auto node_set = a.get_all<Value<double>>();
+        auto nodes = node_set.pointers();
+        auto node_names = node_set.names();
+        for (size_t i = 0; i < nodes.size(); i++) {
+            auto element = element_of(node_names[i], gm);
+            if (dynamic_cast<Backup*>(nodes[i]) != nullptr and dict.contains(element)) {
+                result.nodes[dict.id(element)].push_back(nodes[i]);
+            }
+        }
+        for (size_t i = 0; i < move_names.size(); i++) {
+            auto element = element_of(move_names[i]);
+            if (dict.contains(element)) {
+                result.moves[dict.id(element)].push_back(i);
+            } else {
+                result.other_moves.push_back(i);
+            }
+        }
+        return result;
+    }
+
+    // positions of the moves a worker performs: those of the indexes it owns, and the others
+    std::vector<size_t> active_moves(
+        const Partition& partition, const Migratable& migratable) const {
+        std::vector<size_t> result(migratable.other_moves);
+        for (auto index : partition.my_partition()) {
+            auto& index_moves = migratable.moves[index];
+            result.insert(result.end(), index_moves.begin(), index_moves.end());
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // moves the boundaries between the given slices so that each slice stays within the window of
+    // its process in the migration partition (other indexes are not instantiated there)
+    std::vector<size_t> within_windows(const std::vector<size_t>& sizes) const {
+        auto& initial = *migration_partition;
+        std::vector<size_t> result;
+        size_t cumulated = 0, previous = 0;
+        for (size_t i = 0; i < sizes.size(); i++) {
+            cumulated += sizes[i];
+            size_t boundary = cumulated;
+            if (i + 1 < sizes.size()) {
+                int rank = initial.offset() + i;
+                boundary = std::min(boundary, initial.window_end(rank));
+                boundary = std::max(boundary, initial.window_start(rank + 1));
+                boundary = std::max(boundary, previous);
+            }
+            result.push_back(boundary - previous);
+            previous = boundary;
+        }
+        return result;
+    }
+
+    // collective (all processes, at the same point of an iteration); returns true if partition has
+    // changed, in which case indexes have been migrated to their new owners
+    bool rebalance(Partition& partition, double computing_time, const Migratable& migratable,
+        const std::vector<Move*>& moves) const {
+        std::vector<double> times(compoGM::p.size, 0);
+        MPI_Gather(
+            &computing_time, 1, MPI_DOUBLE, times.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+        // master decides on new slice sizes
+        auto current_sizes = partition.slice_sizes();
+        std::vector<unsigned long long> sizes(current_sizes.begin(), current_sizes.end());
+        if (!compoGM::p.rank) {
+            double max_time = 0, total_time = 0;
+            for (size_t i = 0; i < partition.size(); i++) {
+                max_time = std::max(max_time, times.at(partition.offset() + i));
+                total_time += times.at(partition.offset() + i);
+            }
+            double imbalance = total_time > 0 ? max_time * partition.size() / total_time : 1;
+            if (imbalance > migration_threshold) {
+                // speed of a worker is the number of indexes it processed per ms
+                double mean_speed = partition.partition_size_sum() / total_time;
+                std::vector<double> speeds;
+                for (size_t i = 0; i < partition.size(); i++) {
+                    double time = times.at(partition.offset() + i);
+                    speeds.push_back((current_sizes[i] > 0 and time > 0) ? current_sizes[i] / time
+                                                                         : mean_speed);
+                }
+                auto& indexes = partition.indexes();
+                Partition balanced(indexes, IndexedArray<double>(indexes.dictionary(), 1),
+                    partition.size(), partition.offset(), speeds);
+                auto balanced_sizes = within_windows(balanced.slice_sizes());
+                sizes.assign(balanced_sizes.begin(), balanced_sizes.end());
+            }
+            compoGM::p.message("Rebalancing: measured imbalance is %f", imbalance);
+        }
+        MPI_Bcast(sizes.data(), sizes.size(), MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+        if (std::equal(sizes.begin(), sizes.end(), current_sizes.begin())) { return false; }
+        std::vector<size_t> new_sizes(sizes.begin(), sizes.end());
+        Partition new_partition(partition.indexes(), new_sizes, partition.offset());
+        new_partition.set_margin(partition.margin());
+
+        // migrating indexes that change owner, in the same order on all processes (so that
+        // each send is matched by a receive without deadlock)
+        int nb_migrated = 0;
+        for (auto index : partition.indexes()) {
+            int from = partition.owner(index), to = new_partition.owner(index);
+            if (from == to) { continue; }
+            nb_migrated++;
+            if (compoGM::p.rank == from) {
+                std::vector<double> buffer;  // node values, then size and state of each move
+                for (auto node : migratable.nodes[index]) { buffer.push_back(node->get_ref()); }
+                for (auto position : migratable.moves[index]) {
+                    auto state = moves[position]->get_state();
+                    buffer.push_back(state.size());
+                    buffer.insert(buffer.end(), state.begin(), state.end());
+                }
+                MPI_Send(buffer.data(), buffer.size(), MPI_DOUBLE, to, migration_tag,
+                    MPI_COMM_WORLD);
+            } else if (compoGM::p.rank == to) {
+                MPI_Status status;
+                MPI_Probe(from, migration_tag, MPI_COMM_WORLD, &status);
+                int count = 0;
+                MPI_Get_count(&status, MPI_DOUBLE, &count);
+                std::vector<double> buffer(count);
+                MPI_Recv(buffer.data(), count, MPI_DOUBLE, from, migration_tag, MPI_COMM_WORLD,
+                    MPI_STATUS_IGNORE);
+                size_t pos = 0;
+                for (auto node : migratable.nodes[index]) {
+                    node->get_ref() = buffer.at(pos++);
+                    bump_version(node);
+                }
+                for (auto position : migratable.moves[index]) {
+                    size_t state_size = buffer.at(pos++);
+                    moves[position]->set_state(std::vector<double>(
+                        buffer.begin() + pos, buffer.begin() + pos + state_size));
+                    pos += state_size;
+                }
+            }
+        }
+        compoGM::p.message("Rebalancing: migrated %d indexes", nb_migrated);
+        partition = new_partition;
+        return true;
+    }
+
+    // non-blocking communications (see async)
+    bool async_mode{false};
+
+    // moves (by position) whose footprint reads none of the nodes set by the async proxies of this
+    // process, and that can thus be performed while communications are in flight
+    std::vector<bool> overlappable_moves(const tc::Assembly& a,
+        const std::vector<tc::Address>& move_names,
+        const std::vector<AsyncProxy*>& async_proxies) const {
+        std::set<Value<double>*> incoming_nodes;
+        for (auto proxy : async_proxies) {
+            auto nodes = proxy->incoming();
+            incoming_nodes.insert(nodes.begin(), nodes.end());
+        }
+        NameSet incoming;
+        auto node_set = a.get_all<Value<double>>();
+        auto nodes = node_set.pointers();
+        auto node_names = node_set.names();
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (incoming_nodes.count(nodes[i]) > 0 and gm.is_ancestor(node_names[i])) {
+                incoming.insert(node_names[i].rebase(gm).to_string());
+            }
+        }
+
+        GMIndex index(model.get_composite(gm));
+        std::map<std::string, tc::Address> move_targets;
+        for (auto m : MCMC::moves) {
+            for (auto im : individual_moves(m.target)) {
+                move_targets.insert({im.first.to_string(), im.second});
+            }
+        }
+        std::vector<bool> result;
+        for (auto& name : move_names) {
+            auto target = move_targets.find(name.to_string());
+            if (target == move_targets.end()) {  // not declared through MCMC (e.g., suffstats)
+                result.push_back(false);
+                continue;
+            }
+            auto read = footprint(target->second, index).read;
+            result.push_back(std::none_of(read.begin(), read.end(),
+                [&incoming](const NodeName& node) { return incoming.count(node) > 0; }));
+        }
+        return result;
+    }
+
   public:
-    MpiMCMC(tc::Model& m, tc::Address gm) : MCMC(m, gm) {}
+    MpiMCMC(tc::Model& m, tc::Address gm) : MCMC(m, gm) {
+        auto_suffstats(false);  // suffstats would be acquired along with MPI proxies, in no order
+    }
 
     template <class... Args>
     void master_add(Args&&... args) {
@@ -44,19 +302,156 @@ class MpiMCMC : public MCMC {
         if (compoGM::p.rank != 0) { move(std::forward<Args>(args)...); }
     }
 
+    // calibration run: workers measure the time spent in moves of each element of partition (e.g.,
+    // gene, moves being arrays indexed like the model), which master writes to filename; costs can
+    // then be given to a weighted Partition (see parse_costs)
+    void measure_costs(const Partition& partition, std::string filename) {
+        cost_partition.reset(new Partition(partition));
+        cost_file = filename;
+    }
+
+    // periodic rebalancing: every period iterations, workers report their computing time and, if
+    // the slowest one is more than threshold times slower than the average, master moves the
+    // boundaries of the (contiguous) slices of partition. Indexes (e.g., genes) that change owner
+    // are migrated with the values of their stochastic nodes and the state of their moves.
+    // Workers must instantiate the window of their slice (see Partition::window); slice boundaries
+    // stay within windows, so the margin of partition bounds both replication and migration.
+    void migrate(const Partition& partition, int period, double threshold = 1.1) {
+        if (partition.margin() == 0) {
+            compoGM::p.message("Migration partition has no margin: slices will not change");
+        }
+        migration_partition.reset(new Partition(partition));
+        migration_period = period;
+        migration_threshold = threshold;
+    }
+
+    // non-blocking proxies (see AsyncProxy): each process posts the reception of the values it
+    // uses, performs the moves that do not read them while they are in flight, then waits for
+    // them (acquire time) and performs the other moves. Sending is started after computing and only
+    // completed before the next one (release time).
+    void async(bool enabled = true) { async_mode = enabled; }
+
     void go(int nb_iterations, int nb_rep_master, int np_rep_slave) const {
         // instantiating assembly
         Assembly a(model);
+        seed_moves(a);
 
         // gathering pointers and preparing trace
-        auto moves = a.get_all<Move>().pointers();
+        auto move_set = a.get_all<Move>();
+        auto moves = move_set.pointers();
+        std::vector<double> move_costs(moves.size(), 0);  // ms, if measuring costs
         auto proxies = a.get_all<Proxy>().pointers();
 
+        // moves performed by this process, which change when indexes migrate
+        std::vector<size_t> active(moves.size());
+        std::iota(active.begin(), active.end(), 0);
+        std::unique_ptr<Partition> partition;
+        Migratable migratable;
+        auto repartitionables = a.get_all<Repartitionable>().pointers();
+        auto changes = a.get_all<Changes>().pointers();
+        if (migration_partition) {
+            partition.reset(new Partition(*migration_partition));
+            if (compoGM::p.rank) {
+                migratable = find_migratable(a, move_set.names(), *partition);
+                active = active_moves(*partition, migratable);
+            }
+        }
+        double time_since_rebalance = 0;  // computing time, ms
+
+        // collective moves (e.g., DistributedMHMove) are performed by all processes together, after
+        // master has released its values and before rebalancing, nb_rep_master times
+        std::vector<size_t> collective;
+        std::vector<bool> is_collective(moves.size(), false);
+        for (size_t j = 0; j < moves.size(); j++) {
+            if (dynamic_cast<CollectiveMove*>(moves[j]) != nullptr) {
+                collective.push_back(j);
+                is_collective[j] = true;
+            }
+        }
+        if (partition and !collective.empty()) {
+            // blankets of collective moves on workers would include the indexes they do not own
+            compoGM::p.fail("Collective moves are not supported along with migration");
+        }
+        Chrono collective_time;
+        auto perform_collective = [&](int iteration) {
+            collective_time.start();
+            for (int i = 0; i < nb_rep_master; i++) {
+                for (auto j : collective) { perform_move(moves[j], iteration); }
+            }
+            collective_time.end();
+        };
+        auto rebalance_point = [&](int iteration) {
+            if (!partition or (iteration + 1) % migration_period != 0 or
+                iteration + 1 == nb_iterations) {
+                return;
+            }
+            if (rebalance(*partition, time_since_rebalance, migratable, moves)) {
+                for (auto r : repartitionables) { r->repartition(*partition); }
+                for (auto c : changes) { c->reset(); }  // migrated values were not notified
+                if (compoGM::p.rank) { active = active_moves(*partition, migratable); }
+            }
+            time_since_rebalance = 0;
+        };
+
+        // non-blocking communications: moves that can be performed while they are in flight
+        auto async_proxies = a.get_all<AsyncProxy>().pointers();
+        std::vector<Proxy*> blocking_proxies;  // acquired at wait point and released at start
+        for (auto proxy : proxies) {
+            if (dynamic_cast<AsyncProxy*>(proxy) == nullptr) { blocking_proxies.push_back(proxy); }
+        }
+        std::vector<bool> overlappable(moves.size(), false);
+        if (async_mode and blocking_proxies.empty()) {  // nodes set by the others are unknown
+            overlappable = overlappable_moves(a, move_set.names(), async_proxies);
+        }
+        if (async_mode) {
+            compoGM::p.message("%d moves out of %d are overlapped with communications",
+                int(std::count(overlappable.begin(), overlappable.end(), true)), int(moves.size()));
+        }
+        auto post_receptions = [&]() {
+            for (auto proxy : async_proxies) { proxy->start_acquire(); }
+        };
+        auto wait_receptions = [&]() {
+            for (auto proxy : async_proxies) {
+                if (!proxy->incoming().empty()) { proxy->wait(); }
+            }
+            for (auto proxy : blocking_proxies) { proxy->acquire(); }
+        };
+        auto start_sendings = [&]() {
+            for (auto proxy : async_proxies) { proxy->start_release(); }
+            for (auto proxy : blocking_proxies) { proxy->release(); }
+        };
+        auto wait_all = [&]() {
+            for (auto proxy : async_proxies) { proxy->wait(); }
+        };
+
+        // moves among positions that are (or are not) overlapped, nb_rep times
+        auto perform_moves = [&](const std::vector<size_t>& positions, bool overlapped,
+                                 int nb_rep, int iteration) {
+            for (int i = 0; i < nb_rep; i++) {
+                for (auto j : positions) {
+                    if (is_collective[j] or (async_mode and overlappable[j] != overlapped)) {
+                        continue;
+                    }
+                    if (cost_partition and compoGM::p.rank) {
+                        auto start = std::chrono::high_resolution_clock::now();
+                        perform_move(moves[j], iteration);
+                        auto end = std::chrono::high_resolution_clock::now();
+                        move_costs[j] +=
+                            std::chrono::duration<double, std::milli>(end - start).count();
+                    } else {
+                        perform_move(moves[j], iteration);
+                    }
+                }
+            }
+        };
+        std::vector<size_t> all_moves(moves.size());
+        std::iota(all_moves.begin(), all_moves.end(), 0);
+
         // main loop
         compoGM::p.message("Reaching go barrier");
         MPI_Barrier(MPI_COMM_WORLD);
         compoGM::p.message("Go!");
-        Chrono total_time, computing_time, acquire_time, release_time;
+        Chrono total_time, computing_time, acquire_time, release_time, overlapped_time;
         // master ==================================================================================
         if (!compoGM::p.rank) {
             compoGM::p.message("Setting up trace");
@@ -68,53 +463,89 @@ class MpiMCMC : public MCMC {
             trace.header();
 
             Chrono writing_time;
+            if (async_mode) { post_receptions(); }
             for (int iteration = 0; iteration < nb_iterations; iteration++) {
-                acquire_time.start();
-                for (auto proxy : proxies) { proxy->acquire(); }
-                acquire_time.end();
-                computing_time.start();
-                for (int i = 0; i < nb_rep_master; i++) {
-                    for (auto move : moves) {
-                        move->move(1.0);
-                        move->move(0.1);
-                        move->move(0.01);
-                    }
+                if (async_mode) {
+                    overlapped_time.start();
+                    perform_moves(all_moves, true, nb_rep_master, iteration);
+                    overlapped_time.end();
+                    acquire_time.start();
+                    wait_receptions();
+                    acquire_time.end();
+                } else {
+                    acquire_time.start();
+                    for (auto proxy : proxies) { proxy->acquire(); }
+                    acquire_time.end();
                 }
+                computing_time.start();
+                perform_moves(all_moves, false, nb_rep_master, iteration);
                 computing_time.end();
                 release_time.start();
-                for (auto proxy : proxies) { proxy->release(); }
+                if (async_mode) {
+                    start_sendings();
+                } else {
+                    for (auto proxy : proxies) { proxy->release(); }
+                }
                 release_time.end();
+                if (!collective.empty()) { perform_collective(iteration); }
                 writing_time.start();
                 trace.line();
                 writing_time.end();
+                rebalance_point(iteration);
+                if (async_mode and iteration + 1 < nb_iterations) { post_receptions(); }
             }
+            if (async_mode) { wait_all(); }
             compoGM::p.message("Average writing time is %fms", writing_time.mean());
             // slaves ==============================================================================
         } else {
-            for (auto proxy : proxies) { proxy->release(); }
+            if (async_mode) {
+                start_sendings();
+            } else {
+                for (auto proxy : proxies) { proxy->release(); }
+            }
             for (int iteration = 0; iteration < nb_iterations; iteration++) {
-                acquire_time.start();
-                for (auto proxy : proxies) { proxy->acquire(); }
-                acquire_time.end();
-                computing_time.start();
-                for (int i = 0; i < np_rep_slave; i++) {
-                    for (auto move : moves) {
-                        move->move(1.0);
-                        move->move(0.1);
-                        move->move(0.01);
-                    }
+                if (async_mode) {
+                    post_receptions();
+                    overlapped_time.start();
+                    perform_moves(active, true, np_rep_slave, iteration);
+                    time_since_rebalance += overlapped_time.end();
+                    acquire_time.start();
+                    wait_receptions();
+                    acquire_time.end();
+                } else {
+                    acquire_time.start();
+                    for (auto proxy : proxies) { proxy->acquire(); }
+                    acquire_time.end();
                 }
-                computing_time.end();
+                computing_time.start();
+                perform_moves(active, false, np_rep_slave, iteration);
+                time_since_rebalance += computing_time.end();
+                if (!collective.empty()) { perform_collective(iteration); }
+                rebalance_point(iteration);  // before sending values to master
                 release_time.start();
-                for (auto proxy : proxies) { proxy->release(); }
+                if (!async_mode) {
+                    for (auto proxy : proxies) { proxy->release(); }
+                } else if (iteration + 1 < nb_iterations) {  // last values are not received
+                    start_sendings();
+                }
                 release_time.end();
             }
+            if (async_mode) { wait_all(); }
         }
         double elapsed_time = total_time.end();
         compoGM::p.message("MCMC chain has finished in %fms (%fms/iteration)", elapsed_time,
             elapsed_time / nb_iterations);
         compoGM::p.message("Average computing time is %fms", computing_time.mean());
+        if (!collective.empty()) {
+            compoGM::p.message("Average time in collective moves is %fms", collective_time.mean());
+        }
+        if (async_mode) {
+            compoGM::p.message(
+                "Average computing time overlapped with communications is %fms",
+                overlapped_time.mean());
+        }
         compoGM::p.message("Average acquire time is %fms", acquire_time.mean());
         compoGM::p.message("Average release time is %fms", release_time.mean());
+        if (cost_partition) { write_costs(move_set.names(), move_costs, nb_iterations); }
     }
 };
\ No newline at end of file
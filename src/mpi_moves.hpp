@@ -0,0 +1,130 @@
+/*Copyright or © or Copr. Centre National de la Recherche Scientifique (CNRS) (2018).
+Contributors:
+* Vincent LANORE - vincent.lanore@univ-lyon1.fr
+
+This software is a component-based library to write bayesian inference programs based on the
+graphical model.
+
+This software is governed by the CeCILL-C license under French law and abiding by the rules of
+distribution of free software. You can use, modify and/ or redistribute the software under the terms
+of the CeCILL-C license as circulated by CEA, CNRS and INRIA at the following URL
+"http:////www.cecill.info".
+
+As a counterpart to the access to the source code and rights to copy, modify and redistribute
+granted by the license, users are provided only with a limited warranty and the software's author,
+the holder of the economic rights, and the successive licensors have only limited liability.
+
+In this respect, the user's attention is drawn to the risks associated with loading, using,
+modifying and/or developing or reproducing the software by the user in light of its specific status
+of free software, that may mean that it is complicated to manipulate, and that also therefore means
+that it is reserved for developers and experienced professionals having in-depth computer knowledge.
+Users are therefore encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or data to be ensured and,
+more generally, to use and operate it in the same conditions as regards security.
+
+The fact that you are presently reading this means that you have had knowledge of the CeCILL-C
+license and that you accept its terms.*/
+
+#pragma once
+
+#include <mpi.h>
+#include "mcmc_moves.hpp"
+
+/*
+====================================================================================================
+  ~*~ CollectiveMove interface ~*~
+  Marks moves that all processes perform together, at the same point of an iteration and in the
+  same order (see MpiMCMC::go).
+==================================================================================================*/
+struct CollectiveMove {
+    virtual ~CollectiveMove() = default;
+};
+
+/*
+====================================================================================================
+  ~*~ DistributedMHMove ~*~
+  A Metropolis-Hastings move on a node that all processes have (typically a global parameter) whose
+  blanket is spread over processes: master proposes a value and broadcasts it with the uniform draw
+  of the decision, each process computes the change of the log prob of its part of the blanket, and
+  the total is obtained through an MPI_Allreduce so that all processes take the same decision. The
+  log prob of the target itself is only counted by master. Assuming value type is double.
+==================================================================================================*/
+template <class M>
+class DistributedMHMove : public Move,
+                          public CollectiveMove,
+                          public tc::Component,
+                          public ArenaAllocated {
+    // config
+    Value<double>* target;
+    Backup* target_backup;
+    std::vector<LogProbSelector> log_probs;
+    void add_log_prob(LogProbSelector selector) { log_probs.push_back(selector); }
+    ChangeSubscribers subscribers;  // notified every time the target changes
+    void add_subscription(ChangeSubscription s) { subscribers.add(s); }
+
+    double local_log_prob() {
+        auto target_log_prob = dynamic_cast<LogProb*>(target);
+        double result = 0;
+        for (auto& s : log_probs) {
+            if (!compoGM::p.rank or s.get_ptr() != target_log_prob) { result += s.get_log_prob(); }
+        }
+        return result;
+    }
+
+    RandomStream rng;  // only used by master
+
+    AdaptiveTuning adaptive_tuning;  // proposal width used by adaptive_move (master only)
+
+    // internal stats
+    int reject{0}, total{0};
+
+    bool mh_step(double tuning) {
+        double log_prob_before = local_log_prob();
+        target_backup->backup();  // right before changing value (see Backup interface)
+        double log_ratio = 0;
+        double proposal[2] = {0, 0};  // new value, uniform draw of the decision
+        if (!compoGM::p.rank) {
+            log_ratio = M::move(target->get_ref(), tuning, rng);
+            proposal[0] = target->get_ref();
+            proposal[1] = rng.uniform();
+        }
+        MPI_Bcast(proposal, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if (compoGM::p.rank) { target->get_ref() = proposal[0]; }
+        subscribers.notify();
+        log_ratio += local_log_prob() - log_prob_before;
+
+        double total_log_ratio = 0;
+        MPI_Allreduce(&log_ratio, &total_log_ratio, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        bool accept = proposal[1] <= exp(total_log_ratio);
+        if (not accept) {
+            target_backup->restore();
+            subscribers.notify();
+            reject++;
+        }
+        total++;
+        return accept;
+    }
+
+  public:
+    DistributedMHMove() {
+        port("target", &DistributedMHMove::target);
+        port("targetbackup", &DistributedMHMove::target_backup);
+        port("logprob", &DistributedMHMove::add_log_prob);
+        port("changes", &DistributedMHMove::add_subscription);
+    }
+
+    void move(double tuning = 1.0) final { mh_step(tuning); }
+
+    bool tunable() const final { return true; }
+
+    void adaptive_move(bool adapt) final {
+        bool accept = mh_step(adaptive_tuning.get());
+        if (adapt) { adaptive_tuning.update(accept); }
+    }
+
+    void seed(uint64_t key, uint64_t stream) final { rng.reset(key, stream); }
+
+    double accept_rate() const { return double(total - reject) / total; }
+
+    double tuning() const { return adaptive_tuning.get(); }
+};
@@ -29,6 +29,8 @@ license and that you accept its terms.*/
 
 #include <mpi.h>
 #include "interfaces.hpp"
+#include "mpi_topology.hpp"
+#include "partition.hpp"
 #include "tinycompo.hpp"
 
 struct MPIConnection {
@@ -75,6 +77,7 @@ class ProbNodeUse : public tc::Component, public Proxy {
             MPI_STATUS_IGNORE);
         // compoGM::p.message("Received value %f from %d", buffer, connection.target_process);
         target->get_ref() = buffer;
+        bump_version(target);
     }
 
     void release() override {}
@@ -91,11 +94,22 @@ struct MasterWorkerToggle : public tc::Meta {
     }
 };
 
+// non-blocking mode of collective proxies (see MpiMCMC::async): communications are started, then
+// completed at an explicit wait point, so that computations that do not read the incoming values
+// can be performed in between. Blocking acquire and release are a start followed by a wait.
+struct AsyncProxy {
+    virtual void start_acquire() = 0;  // posts reception of values
+    virtual void start_release() = 0;  // copies values of targets and posts their sending
+    virtual void wait() = 0;           // completes pending communication (if any)
+    virtual std::vector<Value<double>*> incoming() const = 0;  // nodes set by wait
+};
+
 // assuming value type is double
-class MasterBcast : public tc::Component, public Proxy {
+class MasterBcast : public tc::Component, public Proxy, public AsyncProxy {
     std::vector<Value<double>*> targets;
     void add_target(Value<double>* ptr) { targets.push_back(ptr); }
     std::vector<double> data;
+    MPI_Request request{MPI_REQUEST_NULL};
 
   public:
     MasterBcast() { port("target", &MasterBcast::add_target); }
@@ -103,44 +117,91 @@ class MasterBcast : public tc::Component, public Proxy {
     void acquire() override {}
 
     void release() override {
+        start_release();
+        wait();
+    }
+
+    void start_acquire() override {}
+
+    void start_release() override {
+        wait();  // data buffer is in use until then
         int n = targets.size();
-        data.reserve(n);
+        data.clear();
         for (auto target : targets) { data.push_back(target->get_ref()); }
-        MPI_Bcast(data.data(), n, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        MPI_Ibcast(data.data(), n, MPI_DOUBLE, 0, mpi_topology.parent_comm(), &request);
     }
+
+    void wait() override { MPI_Wait(&request, MPI_STATUS_IGNORE); }
+
+    std::vector<Value<double>*> incoming() const override { return {}; }
 };
 
 // assuming value type is double
-class SlaveBcast : public tc::Component, public Proxy {
+class SlaveBcast : public tc::Component, public Proxy, public AsyncProxy {
     std::vector<Value<double>*> targets;
     void add_target(Value<double>* ptr) { targets.push_back(ptr); }
     std::vector<double> data;
+    MPI_Request request{MPI_REQUEST_NULL};
 
   public:
     SlaveBcast() { port("target", &SlaveBcast::add_target); }
 
     void acquire() override {
+        start_acquire();
+        wait();
+    }
+
+    void release() override {}
+
+    void start_acquire() override {
+        wait();
         size_t n = targets.size();
         data.assign(n, -1);
-        MPI_Bcast(data.data(), n, MPI_DOUBLE, 0, MPI_COMM_WORLD);
-        for (size_t i = 0; i < n; i++) { targets[i]->get_ref() = data[i]; }
+        MPI_Ibcast(data.data(), n, MPI_DOUBLE, 0, mpi_topology.parent_comm(), &request);
     }
 
-    void release() override {}
+    void start_release() override {}
+
+    void wait() override {
+        if (request == MPI_REQUEST_NULL) { return; }
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+        if (mpi_topology.aggregator()) {  // relaying values to the workers of the group
+            MPI_Ibcast(data.data(), data.size(), MPI_DOUBLE, 0, mpi_topology.group(), &request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+        }
+        for (size_t i = 0; i < targets.size(); i++) {
+            targets[i]->get_ref() = data[i];
+            bump_version(targets[i]);
+        }
+    }
+
+    std::vector<Value<double>*> incoming() const override { return targets; }
 };
 
 using Bcast = MasterWorkerToggle<MasterBcast, SlaveBcast, tc::Address>;
 
+// proxies whose communications follow a partition that can change during a run (see
+// MpiMCMC::migrate)
+struct Repartitionable {
+    virtual void repartition(const Partition& new_partition) = 0;
+};
+
 // assuming value type is double
-class MasterGather : public tc::Component, public Proxy {
+class MasterGather : public tc::Component,
+                     public Proxy,
+                     public AsyncProxy,
+                     public Repartitionable {
     std::vector<Value<double>*> targets;
     void add_target(Value<double>* ptr) { targets.push_back(ptr); }
     std::vector<double> data;
     Partition partition;
+    MPI_Request request{MPI_REQUEST_NULL};
 
     size_t nb_partitions;
     size_t buffer_size;
-    std::vector<int> displs{0}, revcounts{0};
+    std::vector<int> displs{0}, revcounts{0};  // by rank in the communicator with workers
+    std::vector<int> buffer_order;              // workers in order of their values in buffer
+    std::vector<int> target_displs;             // position of the values of each worker in targets
 
   public:
     MasterGather(Partition partition)
@@ -154,17 +215,53 @@ class MasterGather : public tc::Component, public Proxy {
         }
         port("target", &MasterGather::add_target);
 
-        // preparing gatherv parameters once and for all
+        // preparing gatherv parameters once and for all (until next repartition)
         data.assign(buffer_size, -2);
+        repartition(partition);
+    }
+
+    // with a hierarchical topology, master receives the values of each group of workers from its
+    // aggregator, in the order of the workers in the group
+    void repartition(const Partition& new_partition) override {
+        partition = new_partition;
+        target_displs = {0};
         int displ = 0;
         for (size_t i = 1; i <= nb_partitions; i++) {
-            revcounts.push_back(partition.partition_size(i));
-            displs.push_back(displ);
+            target_displs.push_back(displ);
             displ += partition.partition_size(i);
         }
+
+        std::vector<std::vector<int>> senders;  // groups of workers whose values come together
+        if (mpi_topology.hierarchical()) {
+            senders = mpi_topology.groups();
+        } else {
+            for (size_t i = 1; i <= nb_partitions; i++) { senders.push_back({int(i)}); }
+        }
+        displs = {0};
+        revcounts = {0};
+        buffer_order.clear();
+        displ = 0;
+        for (auto& sender : senders) {
+            int count = 0;
+            for (auto rank : sender) {
+                count += partition.partition_size(rank);
+                buffer_order.push_back(rank);
+            }
+            revcounts.push_back(count);
+            displs.push_back(displ);
+            displ += count;
+        }
     }
 
     void acquire() override {
+        start_acquire();
+        wait();
+    }
+
+    void release() override {}
+
+    void start_acquire() override {
+        wait();
         if (buffer_size != targets.size()) {
             std::cerr << "MasterGather error: number of targets (" << targets.size()
                       << ") doesn't match number of elements in partition ("
@@ -172,24 +269,48 @@ class MasterGather : public tc::Component, public Proxy {
             exit(1);
         }
 
-        MPI_Gatherv(NULL, 0, MPI_DOUBLE, data.data(), revcounts.data(), displs.data(), MPI_DOUBLE,
-            0, MPI_COMM_WORLD);
+        MPI_Igatherv(NULL, 0, MPI_DOUBLE, data.data(), revcounts.data(), displs.data(), MPI_DOUBLE,
+            0, mpi_topology.parent_comm(), &request);
+    }
 
-        for (size_t i = 0; i < buffer_size; i++) { targets.at(i)->get_ref() = data.at(i); }
+    void start_release() override {}
+
+    void wait() override {
+        if (request == MPI_REQUEST_NULL) { return; }
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+        size_t pos = 0;
+        for (auto rank : buffer_order) {
+            size_t start = target_displs.at(rank);
+            for (size_t i = start; i < start + partition.partition_size(rank); i++) {
+                targets.at(i)->get_ref() = data.at(pos++);
+                bump_version(targets.at(i));
+            }
+        }
     }
 
-    void release() override {}
+    std::vector<Value<double>*> incoming() const override { return targets; }
 };
 
-// assuming value type is double
-class WorkerGather : public tc::Component, public Proxy {
+// assuming value type is double; targets are either the elements of the partition of the worker,
+// those of its window, or all elements (in which case the worker sends those of its partition, see
+// MpiMCMC::migrate)
+class WorkerGather : public tc::Component,
+                     public Proxy,
+                     public AsyncProxy,
+                     public Repartitionable {
     std::vector<Value<double>*> targets;
     void add_target(Value<double>* ptr) { targets.push_back(ptr); }
     std::vector<double> data;
+    std::vector<double> group_data;  // values of the workers of the group (aggregators only)
     Partition partition;
+    size_t window_start, window_size;  // window of the initial partition (see Partition::window)
+    MPI_Request request{MPI_REQUEST_NULL};
 
   public:
-    WorkerGather(Partition partition) : partition(partition) {
+    WorkerGather(Partition partition)
+        : partition(partition),
+          window_start(partition.window_start(compoGM::p.rank)),
+          window_size(partition.window_end(compoGM::p.rank) - window_start) {
         if (partition.size() != size_t(compoGM::p.size - 1)) {
             std::cerr << "WorkerGather error: number of partitions (" << partition.size()
                       << ") doesn't match number of workers (" << compoGM::p.size - 1 << ")\n";
@@ -200,19 +321,54 @@ class WorkerGather : public tc::Component, public Proxy {
 
     void acquire() override {}
 
+    void repartition(const Partition& new_partition) override { partition = new_partition; }
+
     void release() override {
+        start_release();
+        wait();
+    }
+
+    void start_acquire() override {}
+
+    void start_release() override {
+        wait();  // data buffer is in use until then
         size_t my_size = partition.my_partition_size();
-        if (my_size != targets.size()) {
+        size_t start = 0;
+        if (targets.size() == partition.partition_size_sum()) {
+            start = partition.slice_start(compoGM::p.rank);
+        } else if (targets.size() == window_size) {
+            start = partition.slice_start(compoGM::p.rank) - window_start;
+        } else if (my_size != targets.size()) {
             std::cerr << "WorkerGather error: number of targets (" << targets.size()
                       << ") doesn't match number of elements in my partition (" << my_size << ")\n";
             exit(1);
         }
         data.assign(my_size, -1);  // filling buffer with -1s
-        for (size_t i = 0; i < my_size; i++) { data[i] = targets[i]->get_ref(); }
-
-        MPI_Gatherv(
-            data.data(), my_size, MPI_DOUBLE, NULL, NULL, NULL, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        for (size_t i = 0; i < my_size; i++) { data[i] = targets[start + i]->get_ref(); }
+
+        if (mpi_topology.aggregator()) {  // gathering the group first, then sending it as a whole
+            std::vector<int> counts, displs;
+            int displ = 0;
+            for (auto rank : mpi_topology.my_group_members()) {
+                counts.push_back(partition.partition_size(rank));
+                displs.push_back(displ);
+                displ += counts.back();
+            }
+            group_data.assign(displ, -1);
+            MPI_Igatherv(data.data(), my_size, MPI_DOUBLE, group_data.data(), counts.data(),
+                displs.data(), MPI_DOUBLE, 0, mpi_topology.group(), &request);
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+            MPI_Igatherv(group_data.data(), displ, MPI_DOUBLE, NULL, NULL, NULL, MPI_DOUBLE, 0,
+                mpi_topology.parent_comm(), &request);
+        } else {
+            MPI_Igatherv(data.data(), my_size, MPI_DOUBLE, NULL, NULL, NULL, MPI_DOUBLE, 0,
+                mpi_topology.parent_comm(), &request);
+        }
     }
+
+    void wait() override { MPI_Wait(&request, MPI_STATUS_IGNORE); }
+
+    std::vector<Value<double>*> incoming() const override { return {}; }
 };
 
 using Gather = MasterWorkerToggle<MasterGather, WorkerGather, tc::Address, Partition&>;
\ No newline at end of file
@@ -0,0 +1,120 @@
+/*Copyright or © or Copr. Centre National de la Recherche Scientifique (CNRS) (2018).
+Contributors:
+* Vincent LANORE - vincent.lanore@univ-lyon1.fr
+
+This software is a component-based library to write bayesian inference programs based on the
+graphical model.
+
+This software is governed by the CeCILL-C license under French law and abiding by the rules of
+distribution of free software. You can use, modify and/ or redistribute the software under the terms
+of the CeCILL-C license as circulated by CEA, CNRS and INRIA at the following URL
+"http:////www.cecill.info".
+
+As a counterpart to the access to the source code and rights to copy, modify and redistribute
+granted by the license, users are provided only with a limited warranty and the software's author,
+the holder of the economic rights, and the successive licensors have only limited liability.
+
+In this respect, the user's attention is drawn to the risks associated with loading, using,
+modifying and/or developing or reproducing the software by the user in light of its specific status
+of free software, that may mean that it is complicated to manipulate, and that also therefore means
+that it is reserved for developers and experienced professionals having in-depth computer knowledge.
+Users are therefore encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or data to be ensured and,
+more generally, to use and operate it in the same conditions as regards security.
+
+The fact that you are presently reading this means that you have had knowledge of the CeCILL-C
+license and that you accept its terms.*/
+
+#pragma once
+
+#include <mpi.h>
+#include <climits>
+#include <map>
+#include <vector>
+#include "computing_entity.hpp"
+
+/*
+====================================================================================================
+  ~*~ MpiTopology ~*~
+  Optional two-level organization of processes for large numbers of workers: workers are split into
+  groups (one per node, or of a given number of consecutive ranks), the first worker of a group
+  being its aggregator. Collective proxies (see mpi_proxies.hpp) then communicate between master and
+  aggregators (leaders communicator, where master is rank 0) and between each aggregator and its
+  group (group communicator, where the aggregator is rank 0), so that master only exchanges one
+  message per group. Without setup, the topology is flat (all processes talk to master).
+==================================================================================================*/
+class MpiTopology {
+    bool enabled{false};
+    MPI_Comm group_comm{MPI_COMM_NULL}, leaders_comm{MPI_COMM_NULL};
+    std::vector<std::vector<int>> all_groups;  // world ranks of the workers of each group
+    int my_group{-1};                          // -1 for master
+
+  public:
+    ~MpiTopology() {
+        int finalized = 0;
+        MPI_Finalized(&finalized);
+        if (!finalized) { release(); }
+    }
+
+    // collective; frees the communicators made by setup (mpi_run calls it before MPI_Finalize)
+    void release() {
+        if (group_comm != MPI_COMM_NULL) { MPI_Comm_free(&group_comm); }
+        if (leaders_comm != MPI_COMM_NULL) { MPI_Comm_free(&leaders_comm); }
+        enabled = false;
+    }
+
+    // collective (all processes, after MPI_Init); group_size 0 makes one group per node
+    void setup(int group_size = 0) {
+        auto& p = compoGM::p;
+        int key = -1;  // identifies the group of a worker
+        if (group_size > 0) {
+            key = p.rank ? (p.rank - 1) / group_size : -1;
+        } else {
+            MPI_Comm node_comm;
+            MPI_Comm_split_type(
+                MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, p.rank, MPI_INFO_NULL, &node_comm);
+            int candidate = p.rank ? p.rank : INT_MAX, first_worker = INT_MAX;
+            MPI_Allreduce(&candidate, &first_worker, 1, MPI_INT, MPI_MIN, node_comm);
+            MPI_Comm_free(&node_comm);
+            key = p.rank ? first_worker : -1;
+        }
+        std::vector<int> keys(p.size, -1);
+        MPI_Allgather(&key, 1, MPI_INT, keys.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+        // groups in order of their first worker, and workers in rank order inside groups
+        std::map<int, std::vector<int>> groups_by_key;
+        for (int rank = 1; rank < p.size; rank++) { groups_by_key[keys[rank]].push_back(rank); }
+        all_groups.clear();
+        for (auto& group : groups_by_key) {
+            if (p.rank and group.first == key) { my_group = all_groups.size(); }
+            all_groups.push_back(group.second);
+        }
+
+        bool leader = !p.rank or all_groups.at(my_group).front() == p.rank;
+        MPI_Comm_split(MPI_COMM_WORLD, p.rank ? my_group : MPI_UNDEFINED, p.rank, &group_comm);
+        MPI_Comm_split(MPI_COMM_WORLD, leader ? 0 : MPI_UNDEFINED, p.rank, &leaders_comm);
+        enabled = true;
+        p.message("Hierarchical topology: %d groups of workers (%d workers in my group)",
+            int(all_groups.size()), p.rank ? int(all_groups.at(my_group).size()) : 0);
+    }
+
+    bool hierarchical() const { return enabled; }
+
+    bool aggregator() const {
+        return enabled and compoGM::p.rank and all_groups.at(my_group).front() == compoGM::p.rank;
+    }
+
+    // communicator in which rank 0 is the parent of this process (master for master itself)
+    MPI_Comm parent_comm() const {
+        if (!enabled) { return MPI_COMM_WORLD; }
+        return (!compoGM::p.rank or aggregator()) ? leaders_comm : group_comm;
+    }
+
+    MPI_Comm group() const { return group_comm; }
+
+    const std::vector<std::vector<int>>& groups() const { return all_groups; }
+
+    const std::vector<int>& my_group_members() const { return all_groups.at(my_group); }
+};
+
+MpiTopology mpi_topology;
@@ -28,15 +28,55 @@ license and that you accept its terms.*/
 #pragma once
 
 #include <tinycompo.hpp>
+#include "arena.hpp"
 #include "interfaces.hpp"
 
+/*
+====================================================================================================
+  ~*~ ParentVersions ~*~
+  Remembers the versions of a list of parents so that deterministic nodes can tell if they need to
+  be recomputed. Parents that are not Versioned are considered to change all the time.
+==================================================================================================*/
+class ParentVersions {
+    std::vector<const Versioned*> parents;
+    mutable std::vector<size_t> seen;
+    mutable bool first{true};
+
+  public:
+    void add(const Value<double>* ptr) {
+        parents.push_back(dynamic_cast<const Versioned*>(ptr));
+        seen.push_back(0);
+    }
+
+    bool changed() const {  // updates seen versions
+        bool result = first;
+        first = false;
+        for (size_t i = 0; i < parents.size(); i++) {
+            if (parents[i] == nullptr) {
+                result = true;
+            } else {
+                auto version = parents[i]->get_version();
+                if (version != seen[i]) {
+                    seen[i] = version;
+                    result = true;
+                }
+            }
+        }
+        return result;
+    }
+};
+
 /*
 ====================================================================================================
   ~*~ Constant ~*~
 ==================================================================================================*/
 template <class ValueType>
-class Constant : public Value<ValueType>, public tc::Component {
+class Constant : public Value<ValueType>,
+                 public Versioned,
+                 public tc::Component,
+                 public ArenaAllocated {
     ValueType x;  // just a buffer for computation of f(a, b, c)
+    size_t version{0};
 
   public:
     Constant(ValueType x) : x(x) { port("x", &Constant::x); }
@@ -45,94 +85,123 @@ class Constant : public Value<ValueType>, public tc::Component {
 
     const ValueType& get_ref() const final { return x; }
 
+    size_t get_version() const final { return version; }
+
+    void bump_version() final { version++; }
+
     std::string debug() const final { return "Constant [" + std::to_string(x) + "]"; }
 };
 
 /*
 ====================================================================================================
-  ~*~ DeterministicMultiNode ~*~
+  ~*~ DeterministicNode ~*~
+  Base class for deterministic nodes: the value is recomputed (by compute()) only when the version
+  of one of the parents has changed since the last computation.
 ==================================================================================================*/
 template <class ValueType>
-class DeterministicMultiNode : public Value<ValueType>, public tc::Component {
-    std::vector<Value<double>*> parents;
-    ValueType (*f)(const std::vector<Value<double>*>&);
-    mutable ValueType x;  // just a buffer for computation of f(parents)
-    void add_parent(Value<double>* ptr) { parents.push_back(ptr); }
-
-  public:
-    DeterministicMultiNode(ValueType (*f)(const std::vector<Value<double>*>&)) : f(f) {
-        port("parent", &DeterministicMultiNode::add_parent);
+class DeterministicNode : public Value<ValueType>,
+                          public Versioned,
+                          public Cached,
+                          public tc::Component,
+                          public ArenaAllocated {
+    mutable size_t version{0};
+
+  protected:
+    ParentVersions parent_versions;
+    mutable ValueType x;  // cached value of f(parents)
+    virtual ValueType compute() const = 0;
+    virtual bool is_cached() const { return true; }  // when false, x is never recomputed
+
+    void refresh() const {
+        if (is_cached() and parent_versions.changed()) {
+            x = compute();
+            version++;
+        }
     }
 
+  public:
     ValueType& get_ref() final {
-        x = f(parents);
+        refresh();
         return x;
     }
 
     const ValueType& get_ref() const final {
-        x = f(parents);
+        refresh();
         return x;
     }
+
+    size_t get_version() const final {
+        refresh();
+        return version;
+    }
+
+    void bump_version() final { version++; }
 };
 
-class Sum : public Value<double>, public tc::Component {
+/*
+====================================================================================================
+  ~*~ DeterministicMultiNode ~*~
+==================================================================================================*/
+template <class ValueType>
+class DeterministicMultiNode : public DeterministicNode<ValueType> {
     std::vector<Value<double>*> parents;
-    mutable double x;  // just a buffer for computation of f(parents)
-    void add_parent(Value<double>* ptr) { parents.push_back(ptr); }
+    ValueType (*f)(const std::vector<Value<double>*>&);
+    void add_parent(Value<double>* ptr) {
+        parents.push_back(ptr);
+        this->parent_versions.add(ptr);
+    }
+
+    ValueType compute() const final { return f(parents); }
+
+  public:
+    DeterministicMultiNode(ValueType (*f)(const std::vector<Value<double>*>&)) : f(f) {
+        this->port("parent", &DeterministicMultiNode::add_parent);
+    }
+};
+
+class Sum : public DeterministicNode<double> {
+    std::vector<Value<double>*> parents;
+    void add_parent(Value<double>* ptr) {
+        parents.push_back(ptr);
+        parent_versions.add(ptr);
+    }
     bool proxy_mode{false};  // no computation when in proxy mode
 
+    double compute() const final {
+        return accumulate(parents.begin(), parents.end(), 0.,
+            [](double acc, Value<double>* ptr) { return acc + ptr->get_ref(); });
+    }
+
+    bool is_cached() const final { return !proxy_mode; }
+
   public:
     Sum() {
         port("parent", &Sum::add_parent);
         port("proxy_mode", &Sum::proxy_mode);
     }
+};
 
-    double& get_ref() final {
-        if (!proxy_mode) {
-            x = accumulate(parents.begin(), parents.end(), 0.,
-                [](double acc, Value<double>* ptr) { return acc + ptr->get_ref(); });
-        }
-        return x;
+class Mean : public DeterministicNode<double> {
+    std::vector<Value<double>*> parents;
+    void add_parent(Value<double>* ptr) {
+        parents.push_back(ptr);
+        parent_versions.add(ptr);
     }
+    bool proxy_mode{false};  // no computation when in proxy mode
 
-    const double& get_ref() const final {
-        if (!proxy_mode) {
-            x = accumulate(parents.begin(), parents.end(), 0.,
-                [](double acc, Value<double>* ptr) { return acc + ptr->get_ref(); });
-        }
-        return x;
+    double compute() const final {
+        return accumulate(parents.begin(), parents.end(), 0.,
+                   [](double acc, Value<double>* ptr) { return acc + ptr->get_ref(); }) /
+               parents.size();
     }
-};
 
-class Mean : public Value<double>, public tc::Component {
-    std::vector<Value<double>*> parents;
-    mutable double x;  // just a buffer for computation of f(parents)
-    void add_parent(Value<double>* ptr) { parents.push_back(ptr); }
-    bool proxy_mode{false};  // no computation when in proxy mode
+    bool is_cached() const final { return !proxy_mode; }
 
   public:
     Mean() {
         port("parent", &Mean::add_parent);
         port("proxy_mode", &Mean::proxy_mode);
     }
-
-    double& get_ref() final {
-        if (!proxy_mode) {
-            x = accumulate(parents.begin(), parents.end(), 0.,
-                    [](double acc, Value<double>* ptr) { return acc + ptr->get_ref(); }) /
-                parents.size();
-        }
-        return x;
-    }
-
-    const double& get_ref() const final {
-        if (!proxy_mode) {
-            x = accumulate(parents.begin(), parents.end(), 0.,
-                    [](double acc, Value<double>* ptr) { return acc + ptr->get_ref(); }) /
-                parents.size();
-        }
-        return x;
-    }
 };
 
 /*
@@ -140,79 +209,88 @@ class Mean : public Value<double>, public tc::Component {
   ~*~ DeterministicTernaryNode ~*~
 ==================================================================================================*/
 template <class ValueType>
-class DeterministicTernaryNode : public Value<ValueType>, public tc::Component {
+class DeterministicTernaryNode : public DeterministicNode<ValueType> {
     Value<double> *a, *b, *c;
     ValueType (*f)(double, double, double);
-    mutable ValueType x;  // just a buffer for computation of f(a, b, c)
+    void set_a(Value<double>* ptr) {
+        a = ptr;
+        this->parent_versions.add(ptr);
+    }
+    void set_b(Value<double>* ptr) {
+        b = ptr;
+        this->parent_versions.add(ptr);
+    }
+    void set_c(Value<double>* ptr) {
+        c = ptr;
+        this->parent_versions.add(ptr);
+    }
+
+    ValueType compute() const final { return f(a->get_ref(), b->get_ref(), c->get_ref()); }
 
   public:
-    DeterministicTernaryNode(ValueType (*f)(double, double, double)) : f(f) {
-        port("a", &DeterministicTernaryNode::a);
-        port("b", &DeterministicTernaryNode::b);
-        port("c", &DeterministicTernaryNode::c);
-    }
+    using Function = ValueType (*)(double, double, double);
 
-    ValueType& get_ref() final {
-        x = f(a->get_ref(), b->get_ref(), c->get_ref());
-        return x;
+    DeterministicTernaryNode(Function f) : f(f) {
+        this->port("a", &DeterministicTernaryNode::set_a);
+        this->port("b", &DeterministicTernaryNode::set_b);
+        this->port("c", &DeterministicTernaryNode::set_c);
     }
 
-    const ValueType& get_ref() const final {
-        x = f(a->get_ref(), b->get_ref(), c->get_ref());
-        return x;
-    }
+    Function get_function() const { return f; }
 
     std::string debug() const final {
-        return "DeterministicTernaryNode [" + std::to_string(get_ref()) + "]";
+        return "DeterministicTernaryNode [" + std::to_string(this->get_ref()) + "]";
     }
 };
 
+// product of its three parents (recognized as such by conjugate updates, see ProductOfParents)
+class Product : public DeterministicTernaryNode<double>, public ProductOfParents {
+    static double product(double a, double b, double c) { return a * b * c; }
+
+  public:
+    Product() : DeterministicTernaryNode<double>(product) {}
+};
+
 /*
 ====================================================================================================
   ~*~ DeterministicUnaryNode ~*~
 ==================================================================================================*/
 template <class ValueType>
-class DeterministicUnaryNode : public Value<ValueType>, public tc::Component {
+class DeterministicUnaryNode : public DeterministicNode<ValueType> {
     Value<double>* parent;
     ValueType (*f)(double);
-    mutable ValueType x;  // just a buffer for computation of f(a, b, c)
+    void set_parent(Value<double>* ptr) {
+        parent = ptr;
+        this->parent_versions.add(ptr);
+    }
+
+    ValueType compute() const final { return f(parent->get_ref()); }
 
   public:
-    DeterministicUnaryNode(ValueType (*f)(double)) : f(f) {
-        port("a", &DeterministicUnaryNode::parent);
-    }
+    using Function = ValueType (*)(double);
 
-    ValueType& get_ref() final {
-        x = f(parent->get_ref());
-        return x;
+    DeterministicUnaryNode(Function f) : f(f) {
+        this->port("a", &DeterministicUnaryNode::set_parent);
     }
 
-    const ValueType& get_ref() const final {
-        x = f(parent->get_ref());
-        return x;
-    }
+    Function get_function() const { return f; }
 
     std::string debug() const final {
-        return "DeterministicUnaryNode [" + std::to_string(get_ref()) + "]";
+        return "DeterministicUnaryNode [" + std::to_string(this->get_ref()) + "]";
     }
 };
 
-class Power10 : public Value<double>, public tc::Component {
+class Power10 : public DeterministicNode<double> {
     Value<double>* parent;
-    mutable double x;  // just a buffer for computation of f(a, b, c)
-
-  public:
-    Power10() { port("a", &Power10::parent); }
-
-    double& get_ref() final {
-        x = pow(10, parent->get_ref());
-        return x;
+    void set_parent(Value<double>* ptr) {
+        parent = ptr;
+        parent_versions.add(ptr);
     }
 
-    const double& get_ref() const final {
-        x = pow(10, parent->get_ref());
-        return x;
-    }
+    double compute() const final { return pow(10, parent->get_ref()); }
+
+  public:
+    Power10() { port("a", &Power10::set_parent); }
 
     std::string debug() const final { return "Power10 [" + std::to_string(get_ref()) + "]"; }
 };
@@ -225,18 +303,32 @@ template <class PDS>
 class BinaryNode : public Value<typename PDS::ValueType>,
                    public LogProb,
                    public Backup,
-                   public tc::Component {
+                   public Versioned,
+                   public VersionedLogProb,
+                   public tc::Component,
+                   public ArenaAllocated {
     using ValueType = typename PDS::ValueType;
     ValueType value{0};
     ValueType bk_value{0};
+    size_t version{0};
     Value<double>* a{nullptr};
     Value<double>* b{nullptr};
+    const Versioned* a_version{nullptr};
+    const Versioned* b_version{nullptr};
+    void set_a(Value<double>* ptr) {
+        a = ptr;
+        a_version = dynamic_cast<const Versioned*>(ptr);
+    }
+    void set_b(Value<double>* ptr) {
+        b = ptr;
+        b_version = dynamic_cast<const Versioned*>(ptr);
+    }
 
   public:
     BinaryNode(ValueType value) : value(value) {
         port("x", &BinaryNode::value);
-        port("a", &BinaryNode::a);
-        port("b", &BinaryNode::b);
+        port("a", &BinaryNode::set_a);
+        port("b", &BinaryNode::set_b);
     }
     ValueType& get_ref() final { return value; }
     const ValueType& get_ref() const final { return value; }
@@ -250,8 +342,19 @@ class BinaryNode : public Value<typename PDS::ValueType>,
     double get_log_prob_b() final {
         return PDS::partial_log_prob_b(value, a->get_ref(), b->get_ref());
     }
-    void backup() final { bk_value = value; }
-    void restore() final { value = bk_value; }
+    void backup() final {
+        bk_value = value;
+        version++;
+    }
+    void restore() final {
+        value = bk_value;
+        version++;
+    }
+    size_t get_version() const final { return version; }
+    void bump_version() final { version++; }
+    size_t get_log_prob_version() const final {
+        return version + version_of(a_version) + version_of(b_version);
+    }
     std::string debug() const final { return "BinaryNode [" + std::to_string(value) + "]"; }
 };
 
@@ -265,24 +368,42 @@ template <class PDS>
 class UnaryNode : public Value<typename PDS::ValueType>,
                   public LogProb,
                   public Backup,
-                  public tc::Component {
+                  public Versioned,
+                  public VersionedLogProb,
+                  public tc::Component,
+                  public ArenaAllocated {
     using ValueType = typename PDS::ValueType;
     ValueType value{0};
     ValueType bk_value{0};
+    size_t version{0};
     Value<double>* parent{nullptr};  // FIXME, template parameter?
+    const Versioned* parent_version{nullptr};
+    void set_parent(Value<double>* ptr) {
+        parent = ptr;
+        parent_version = dynamic_cast<const Versioned*>(ptr);
+    }
 
   public:
     UnaryNode(ValueType value) : value(value) {
         port("x", &UnaryNode::value);
-        port("a", &UnaryNode::parent);
+        port("a", &UnaryNode::set_parent);
     }
     ValueType& get_ref() final { return value; }
     const ValueType& get_ref() const final { return value; }
     double get_log_prob() final { return PDS::full_log_prob(value, parent->get_ref()); }
     double get_log_prob_x() final { return PDS::partial_log_prob_x(value, parent->get_ref()); }
     double get_log_prob_a() final { return PDS::partial_log_prob_a(value, parent->get_ref()); }
-    void backup() final { bk_value = value; }
-    void restore() final { value = bk_value; }
+    void backup() final {
+        bk_value = value;
+        version++;
+    }
+    void restore() final {
+        value = bk_value;
+        version++;
+    }
+    size_t get_version() const final { return version; }
+    void bump_version() final { version++; }
+    size_t get_log_prob_version() const final { return version + version_of(parent_version); }
     std::string debug() const override { return "UnaryNode [" + std::to_string(value) + "]"; }
 };
 
@@ -296,22 +417,153 @@ template <class PDS>
 class OrphanNode : public Value<typename PDS::ValueType>,
                    public LogProb,
                    public Backup,
-                   public tc::Component {
+                   public Versioned,
+                   public VersionedLogProb,
+                   public tc::Component,
+                   public ArenaAllocated {
     using ValueType = typename PDS::ValueType;
     ValueType value{0};
     ValueType bk_value{0};
+    size_t version{0};
     std::function<double(ValueType)> f;  // std::function is used as a way to store constructor args
+    std::vector<double> parameters;
 
   public:
     template <class... Args>
     OrphanNode(double value, Args... args)
-        : value(value), f([args...](ValueType v) { return PDS::partial_log_prob_x(v, args...); }) {
+        : value(value),
+          f([args...](ValueType v) { return PDS::partial_log_prob_x(v, args...); }),
+          parameters{double(args)...} {
         port("x", &OrphanNode::value);
     }
+
+    const std::vector<double>& get_parameters() const { return parameters; }
     ValueType& get_ref() final { return value; }
     const ValueType& get_ref() const final { return value; }
     double get_log_prob() final { return f(value); }
-    void backup() final { bk_value = value; }
-    void restore() final { value = bk_value; }
+    void backup() final {
+        bk_value = value;
+        version++;
+    }
+    void restore() final {
+        value = bk_value;
+        version++;
+    }
+    size_t get_version() const final { return version; }
+    void bump_version() final { version++; }
+    size_t get_log_prob_version() const final { return version; }
     std::string debug() const override { return "OrphanNode [" + std::to_string(value) + "]"; }
 };
+
+/*
+====================================================================================================
+  ~*~ Observed nodes ~*~
+  Nodes whose value is observed data: it is set once at assembly (through port x) and can never
+  be moved (they provide no Backup interface). Data-only terms of the log prob (e.g., log(x!) for
+  Poisson, log(x) for gamma) are computed once when the value is set.
+==================================================================================================*/
+template <class PDS>
+class ObservedUnaryNode : public Value<typename PDS::ValueType>,
+                          public LogProb,
+                          public Versioned,
+                          public VersionedLogProb,
+                          public tc::Component,
+                          public ArenaAllocated {
+    using ValueType = typename PDS::ValueType;
+    ValueType value{0};
+    typename PDS::Data data;
+    size_t version{0};
+    Value<double>* parent{nullptr};
+    const Versioned* parent_version{nullptr};
+    void set_parent(Value<double>* ptr) {
+        parent = ptr;
+        parent_version = dynamic_cast<const Versioned*>(ptr);
+    }
+
+    void set_value(ValueType v) {
+        value = v;
+        data = PDS::data(v);
+    }
+
+  public:
+    ObservedUnaryNode(ValueType value) {
+        set_value(value);
+        port("x", &ObservedUnaryNode::set_value);
+        port("a", &ObservedUnaryNode::set_parent);
+    }
+    ValueType& get_ref() final { return value; }
+    const ValueType& get_ref() const final { return value; }
+    double get_log_prob() final { return PDS::full_log_prob(value, data, parent->get_ref()); }
+    double get_log_prob_a() final {
+        return PDS::partial_log_prob_a(value, data, parent->get_ref());
+    }
+    size_t get_version() const final { return version; }
+    void bump_version() final {  // value was overwritten through get_ref
+        data = PDS::data(value);
+        version++;
+    }
+    size_t get_log_prob_version() const final { return version + version_of(parent_version); }
+    std::string debug() const override {
+        return "ObservedUnaryNode [" + std::to_string(value) + "]";
+    }
+};
+
+template <class PDS>
+class ObservedBinaryNode : public Value<typename PDS::ValueType>,
+                           public LogProb,
+                           public Versioned,
+                           public VersionedLogProb,
+                           public tc::Component,
+                           public ArenaAllocated {
+    using ValueType = typename PDS::ValueType;
+    ValueType value{0};
+    typename PDS::Data data;
+    size_t version{0};
+    Value<double>* a{nullptr};
+    Value<double>* b{nullptr};
+    const Versioned* a_version{nullptr};
+    const Versioned* b_version{nullptr};
+    void set_a(Value<double>* ptr) {
+        a = ptr;
+        a_version = dynamic_cast<const Versioned*>(ptr);
+    }
+    void set_b(Value<double>* ptr) {
+        b = ptr;
+        b_version = dynamic_cast<const Versioned*>(ptr);
+    }
+
+    void set_value(ValueType v) {
+        value = v;
+        data = PDS::data(v);
+    }
+
+  public:
+    ObservedBinaryNode(ValueType value) {
+        set_value(value);
+        port("x", &ObservedBinaryNode::set_value);
+        port("a", &ObservedBinaryNode::set_a);
+        port("b", &ObservedBinaryNode::set_b);
+    }
+    ValueType& get_ref() final { return value; }
+    const ValueType& get_ref() const final { return value; }
+    double get_log_prob() final {
+        return PDS::full_log_prob(value, data, a->get_ref(), b->get_ref());
+    }
+    double get_log_prob_a() final {
+        return PDS::partial_log_prob_a(value, data, a->get_ref(), b->get_ref());
+    }
+    double get_log_prob_b() final {
+        return PDS::partial_log_prob_b(value, data, a->get_ref(), b->get_ref());
+    }
+    size_t get_version() const final { return version; }
+    void bump_version() final {  // value was overwritten through get_ref
+        data = PDS::data(value);
+        version++;
+    }
+    size_t get_log_prob_version() const final {
+        return version + version_of(a_version) + version_of(b_version);
+    }
+    std::string debug() const override {
+        return "ObservedBinaryNode [" + std::to_string(value) + "]";
+    }
+};
@@ -48,9 +48,9 @@ std::ifstream open_file(std::string filename) {
   ~*~ Counts parsing ~*~
 ==================================================================================================*/
 struct CountParsingResult {
-    std::map<std::string, std::map<std::string, int>> counts;  // gene -> sample -> count
+    IndexedMatrix<int> counts;  // gene x sample
     IndexSet genes;
-    std::vector<std::string> samples;  // list of samples in counts file
+    IndexSet samples;  // samples in counts file
 };
 
 CountParsingResult parse_counts(std::string filename) {
@@ -58,24 +58,43 @@ CountParsingResult parse_counts(std::string filename) {
     auto file = open_file(filename);
     auto parser = CsvParser(file).delimiter('\t');
 
-    // Result structure
-    CountParsingResult result;
+    // Lines are read in file order, then counts are stored by gene and sample ids
+    std::vector<std::string> gene_names, sample_names;
+    std::vector<int> raw_counts;
 
     // Counts array
     auto&& line = parser.begin();
     for (int i = 1; i < static_cast<int>(line->size()); ++i) {  // first line of counts file
-        result.samples.push_back((*line)[i]);
-        // cout << "Sample " << i << ": " << (*line)[i] << std::endl;
+        sample_names.push_back((*line)[i]);
     }
-    compoGM::p.message("Number of samples is %d", result.samples.size());
+    compoGM::p.message("Number of samples is %d", int(sample_names.size()));
     for (++line; line != parser.end(); ++line) {  // rest of the lines
-        std::string gene = (*line)[0];
-        result.genes.insert(gene);
+        gene_names.push_back((*line)[0]);
+        if (line->size() != sample_names.size() + 1) {
+            compoGM::p.fail("Line of gene %s has %d counts instead of %d",
+                gene_names.back().c_str(), int(line->size()) - 1, int(sample_names.size()));
+        }
         for (int i = 1; i < static_cast<int>(line->size()); ++i) {
-            result.counts[gene][result.samples.at(i - 1)] = stoi((*line)[i]);
+            raw_counts.push_back(stoi((*line)[i]));
+        }
+    }
+
+    // Result structure
+    CountParsingResult result;
+    auto genes = std::make_shared<IndexDictionary>(gene_names);
+    auto samples = std::make_shared<IndexDictionary>(sample_names);
+    result.genes = IndexSet(genes);
+    result.samples = IndexSet(samples);
+    result.counts = IndexedMatrix<int>(genes, samples, 0);
+    std::vector<Index> sample_ids;
+    for (auto&& sample : sample_names) { sample_ids.push_back(samples->id(sample)); }
+    for (size_t g = 0; g < gene_names.size(); g++) {
+        Index gene = genes->id(gene_names[g]);
+        for (size_t s = 0; s < sample_ids.size(); s++) {
+            result.counts(gene, sample_ids[s]) = raw_counts[g * sample_ids.size() + s];
         }
     }
-    compoGM::p.message("Number of genes is %d", result.counts.size());
+    compoGM::p.message("Number of genes is %d", int(result.genes.size()));
     return result;
 }
 
@@ -94,16 +113,24 @@ SamplesParsingResult parse_samples(std::string filename) {
     auto file = open_file(filename);
     auto parser = CsvParser(file).delimiter('\t');
 
+    std::vector<std::string> sample_names, condition_names;
+    for (auto line = ++parser.begin(); line != parser.end(); ++line) {
+        sample_names.push_back((*line)[0]);
+        condition_names.push_back((*line)[1]);
+    }
+
     // Result structure
     SamplesParsingResult result;
-
-    for (auto line = ++parser.begin(); line != parser.end(); ++line) {
-        result.conditions.insert((*line)[1]);
-        result.samples.insert((*line)[0]);
-        result.condition_mapping[(*line)[0]] = (*line)[1];
-        // cout << (*line)[0] << ", " << (*line)[1] << endl;
+    auto samples = std::make_shared<IndexDictionary>(sample_names);
+    auto conditions = std::make_shared<IndexDictionary>(condition_names);
+    result.samples = IndexSet(samples);
+    result.conditions = IndexSet(conditions);
+    result.condition_mapping = IndexMapping(samples, conditions);
+    for (size_t i = 0; i < sample_names.size(); i++) {
+        result.condition_mapping.set(
+            samples->id(sample_names[i]), conditions->id(condition_names[i]));
     }
-    compoGM::p.message("Number of conditions is %d", result.conditions.size());
+    compoGM::p.message("Number of conditions is %d", int(result.conditions.size()));
     return result;
 }
 
@@ -113,7 +140,7 @@ SamplesParsingResult parse_samples(std::string filename) {
 ==================================================================================================*/
 struct SizeFactorResult {
     IndexSet samples;
-    std::map<std::string, double> size_factors;
+    IndexedArray<double> size_factors;
 };
 
 SizeFactorResult parse_size_factors(std::string filename) {
@@ -121,14 +148,53 @@ SizeFactorResult parse_size_factors(std::string filename) {
     auto file = open_file(filename);
     auto parser = CsvParser(file).delimiter('\t');
 
+    std::vector<std::string> sample_names;
+    std::vector<double> values;
+    for (auto line = ++parser.begin(); line != parser.end(); ++line) {
+        sample_names.push_back((*line)[0]);
+        values.push_back(stod((*line)[1]));
+    }
+
     // Result structure
     SizeFactorResult result;
+    auto samples = std::make_shared<IndexDictionary>(sample_names);
+    result.samples = IndexSet(samples);
+    result.size_factors = IndexedArray<double>(samples, 0);
+    for (size_t i = 0; i < sample_names.size(); i++) {
+        result.size_factors[samples->id(sample_names[i])] = values[i];
+    }
+    return result;
+}
+
+/*
+====================================================================================================
+  ~*~ Index costs parsing ~*~
+  Costs of indexes (e.g., computing time per gene written by a calibration run, see
+  MpiMCMC::measure_costs), by id of a given index set. Indexes missing from the file get the mean
+  cost, names that are not in the index set are ignored.
+==================================================================================================*/
+IndexedArray<double> parse_costs(std::string filename, const IndexSet& indexes) {
+    // Files and parsers
+    auto file = open_file(filename);
+    auto parser = CsvParser(file).delimiter('\t');
 
+    std::vector<std::pair<Index, double>> costs;
     for (auto line = ++parser.begin(); line != parser.end(); ++line) {
-        result.samples.insert((*line)[0]);
-        result.size_factors[(*line)[0]] = stod((*line)[1]);
+        if (indexes.dictionary()->contains((*line)[0])) {
+            costs.emplace_back(indexes.dictionary()->id((*line)[0]), stod((*line)[1]));
+        }
     }
+    compoGM::p.message(
+        "Got costs for %d out of %d indexes", int(costs.size()), int(indexes.size()));
 
+    // Result structure
+    double mean = 1;
+    if (!costs.empty()) {
+        mean = 0;
+        for (auto&& cost : costs) { mean += cost.second / costs.size(); }
+    }
+    IndexedArray<double> result(indexes.dictionary(), mean);
+    for (auto&& cost : costs) { result[cost.first] = cost.second; }
     return result;
 }
 
@@ -136,21 +202,21 @@ SizeFactorResult parse_size_factors(std::string filename) {
 ====================================================================================================
   ~*~ Checking consistency between counts and samples ~*~
 ==================================================================================================*/
-void check_consistency(CountParsingResult counts, SamplesParsingResult samples) {
+void check_consistency(const CountParsingResult& counts, const SamplesParsingResult& samples) {
     // Checking that the two files samples identifiers match
-    if (IndexSet(counts.samples.begin(), counts.samples.end()) == samples.samples) {
+    if (counts.samples == samples.samples) {
         compoGM::p.message("List of samples in counts and samples match!");
     } else {
         compoGM::p.message(
             "Mismatch between sample list in counts file (%d samples) and samples file (%d "
             "samples)",
-            counts.samples.size(), samples.samples.size());
+            int(counts.samples.size()), int(samples.samples.size()));
         exit(1);
     }
 }
 
-void check_consistency(
-    CountParsingResult counts, SamplesParsingResult samples, SizeFactorResult size_factors) {
+void check_consistency(const CountParsingResult& counts, const SamplesParsingResult& samples,
+    const SizeFactorResult& size_factors) {
     check_consistency(counts, samples);
     if (size_factors.samples == samples.samples) {
         compoGM::p.message("List of samples in samples and size factors match!");
@@ -158,7 +224,7 @@ void check_consistency(
         compoGM::p.message(
             "Mismatch between sample list in samples file (%d samples) and size factor file (%d "
             "samples)",
-            samples.samples.size(), size_factors.samples.size());
+            int(samples.samples.size()), int(size_factors.samples.size()));
         exit(1);
     }
 }
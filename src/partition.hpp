@@ -27,34 +27,101 @@ license and that you accept its terms.*/
 
 #pragma once
 
-#include <map>
+#include <algorithm>
 #include <numeric>
-#include <set>
-#include <string>
 #include <vector>
 #include "computing_entity.hpp"
+#include "indices.hpp"
 
 // ================================================================================================
 // classes and data types
-using Index = std::string;
-using IndexSet = std::set<Index>;
-using IndexMapping = std::map<Index, Index>;
 
+/*
+====================================================================================================
+  ~*~ Partition ~*~
+  Splits a set of indexes into contiguous slices (in index order, which is the order in which
+  gathers concatenate them), one per process starting at rank offset. Slices either have the same
+  number of indexes, or balance a per-index cost (e.g., measured during a calibration run, see
+  MpiMCMC::measure_costs) divided by the relative speed of each process. The window of a process
+  is its slice extended by margin neighbouring indexes on each side: the indexes it instantiates
+  when slice boundaries may move (see MpiMCMC::migrate).
+==================================================================================================*/
 class Partition {
     size_t _offset, _size;
+    size_t _margin{0};
     std::vector<IndexSet> partition;
+    IndexSet all;
+    std::vector<double> costs;  // total cost of each slice (number of indexes if unweighted)
+    std::vector<double> speeds;
+    std::vector<int> owners;    // index id -> owning process (-1 if not in partition)
+
+    void build_owners() {
+        owners.assign(all.empty() ? 0 : all.dictionary()->size(), -1);
+        for (size_t i = 0; i < _size; i++) {
+            for (auto index : partition[i]) { owners[index] = i + _offset; }
+        }
+    }
 
   public:
-    Partition(IndexSet indexes, size_t size, size_t offset = 0) : _offset(offset), _size(size) {
+    Partition(IndexSet indexes, size_t size, size_t offset = 0)
+        : _offset(offset), _size(size), all(indexes), speeds(size, 1) {
         size_t nb_indexes = indexes.size();
         for (size_t i = 0; i < _size; i++) {
-            auto begin = indexes.begin();
-            std::advance(begin, i * nb_indexes / size);
-            auto end = indexes.begin();
-            std::advance(end, (i + 1) * nb_indexes / size);
-            partition.emplace_back(begin, end);
+            partition.push_back(indexes.subset(i * nb_indexes / size, (i + 1) * nb_indexes / size));
+            costs.push_back(partition.back().size());
             // compoGM::p.message("Partition %d contains %d elements", i, partition.back().size());
         }
+        build_owners();
+    }
+
+    // index_costs are given by id of the dictionary of indexes; process_speeds are relative speeds
+    // of processes offset, offset + 1... (all equal if empty)
+    Partition(IndexSet indexes, const IndexedArray<double>& index_costs, size_t size,
+        size_t offset = 0, std::vector<double> process_speeds = {})
+        : _offset(offset), _size(size), all(indexes), costs(size, 0), speeds(process_speeds) {
+        if (index_costs.dictionary() != indexes.dictionary()) {
+            compoGM::p.fail("Partition: costs and indexes use different dictionaries");
+        }
+        if (speeds.empty()) { speeds.assign(size, 1); }
+        if (speeds.size() != size) {
+            compoGM::p.fail("Partition: %d speeds given for %d processes", int(speeds.size()),
+                int(size));
+        }
+        // slice i ends where the cumulated cost reaches its share of the total (to the nearest)
+        double total_cost = 0, total_speed = std::accumulate(speeds.begin(), speeds.end(), 0.);
+        for (auto index : indexes) { total_cost += index_costs[index]; }
+        size_t begin = 0, end = 0;
+        double cumulated_cost = 0, cumulated_speed = 0;
+        for (size_t i = 0; i < _size; i++) {
+            cumulated_speed += speeds[i];
+            double target = total_cost * cumulated_speed / total_speed;
+            while (end < indexes.size()) {
+                double cost = index_costs[indexes[end]];
+                if (cumulated_cost + cost / 2 > target and i + 1 < _size) { break; }
+                cumulated_cost += cost;
+                costs[i] += cost;
+                end++;
+            }
+            partition.push_back(indexes.subset(begin, end));
+            begin = end;
+        }
+        build_owners();
+    }
+
+    // slices of given sizes (e.g., after a rebalancing, see MpiMCMC::migrate)
+    Partition(IndexSet indexes, const std::vector<size_t>& slice_sizes, size_t offset = 0)
+        : _offset(offset), _size(slice_sizes.size()), all(indexes), speeds(_size, 1) {
+        size_t begin = 0;
+        for (auto slice_size : slice_sizes) {
+            partition.push_back(indexes.subset(begin, begin + slice_size));
+            costs.push_back(slice_size);
+            begin += slice_size;
+        }
+        if (begin != indexes.size()) {
+            compoGM::p.fail("Partition: slices cover %d indexes out of %d", int(begin),
+                int(indexes.size()));
+        }
+        build_owners();
     }
 
     IndexSet get_partition(int i) const {
@@ -62,14 +129,11 @@ class Partition {
         if (index >= 0 and index < int(_size)) {
             return partition.at(index);
         } else {  // if not in partition, returning everything
-            IndexSet result;
-            for (auto subpartition : partition) {
-                result.insert(subpartition.begin(), subpartition.end());
-            }
-            return result;
+            return all;
         }
     }
     IndexSet my_partition() const { return get_partition(compoGM::p.rank); }
+    const IndexSet& indexes() const { return all; }
 
     size_t partition_size(int i) const {
         int index = i - _offset;
@@ -80,30 +144,59 @@ class Partition {
         }
     }
     size_t my_partition_size() const { return partition_size(compoGM::p.rank); }
-    size_t partition_size_sum() const {
-        return std::accumulate(partition.begin(), partition.end(), 0,
-            [](int acc, IndexSet r) { return acc + r.size(); });
+    size_t partition_size_sum() const { return all.size(); }
+
+    // position of the first index of slice i among all indexes
+    size_t slice_start(int i) const {
+        size_t result = 0;
+        for (int j = 0; j < i - int(_offset); j++) { result += partition.at(j).size(); }
+        return result;
+    }
+
+    void set_margin(size_t margin) { _margin = margin; }
+    size_t margin() const { return _margin; }
+
+    // positions of the first and past-the-last indexes of the window of i among all indexes
+    size_t window_start(int i) const {
+        int index = i - _offset;
+        if (index < 0 or index >= int(_size)) { return 0; }
+        size_t start = slice_start(i);
+        return start - std::min(start, _margin);
+    }
+    size_t window_end(int i) const {
+        int index = i - _offset;
+        if (index < 0 or index >= int(_size)) { return all.size(); }
+        return std::min(all.size(), slice_start(i) + partition.at(index).size() + _margin);
+    }
+    IndexSet window(int i) const { return all.subset(window_start(i), window_end(i)); }
+    IndexSet my_window() const { return window(compoGM::p.rank); }
+
+    std::vector<size_t> slice_sizes() const {
+        std::vector<size_t> result;
+        for (auto& slice : partition) { result.push_back(slice.size()); }
+        return result;
     }
 
     size_t size() const { return _size; }
+    size_t offset() const { return _offset; }
 
     size_t max_partition_size() const {
         return std::accumulate(partition.begin(), partition.end(), 0,
-            [](size_t max, IndexSet s) { return s.size() > max ? s.size() : max; });
+            [](size_t max, const IndexSet& s) { return s.size() > max ? s.size() : max; });
+    }
+
+    double partition_cost(int i) const { return costs.at(i - _offset); }
+
+    // ratio between the longest slice time (cost / speed) and the ideal one (1 is balanced)
+    double imbalance() const {
+        double total_cost = std::accumulate(costs.begin(), costs.end(), 0.);
+        double total_speed = std::accumulate(speeds.begin(), speeds.end(), 0.);
+        double max_time = 0;
+        for (size_t i = 0; i < _size; i++) { max_time = std::max(max_time, costs[i] / speeds[i]); }
+        return total_cost > 0 ? max_time * total_speed / total_cost : 1;
     }
 
     int owner(Index index) const {
-        for (size_t i = 0; i < _size; i++) {
-            auto subpartition = partition.at(i);
-            if (subpartition.find(index) != subpartition.end()) {
-                // compoGM::p.message("Owner of %s is %d", index.c_str(), i+offset);
-                return i + _offset;
-            }
-        }
-        return -1;
+        return (index >= 0 and size_t(index) < owners.size()) ? owners[index] : -1;
     }
 };
-
-// ================================================================================================
-// object creation and conversion
-IndexSet make_index_set(std::vector<Index>& v) { return IndexSet(v.begin(), v.end()); }
\ No newline at end of file
@@ -0,0 +1,151 @@
+/*Copyright or © or Copr. Centre National de la Recherche Scientifique (CNRS) (2018).
+Contributors:
+* Vincent LANORE - vincent.lanore@univ-lyon1.fr
+
+This software is a component-based library to write bayesian inference programs based on the
+graphical model.
+
+This software is governed by the CeCILL-C license under French law and abiding by the rules of
+distribution of free software. You can use, modify and/ or redistribute the software under the terms
+of the CeCILL-C license as circulated by CEA, CNRS and INRIA at the following URL
+"http:////www.cecill.info".
+
+As a counterpart to the access to the source code and rights to copy, modify and redistribute
+granted by the license, users are provided only with a limited warranty and the software's author,
+the holder of the economic rights, and the successive licensors have only limited liability.
+
+In this respect, the user's attention is drawn to the risks associated with loading, using,
+modifying and/or developing or reproducing the software by the user in light of its specific status
+of free software, that may mean that it is complicated to manipulate, and that also therefore means
+that it is reserved for developers and experienced professionals having in-depth computer knowledge.
+Users are therefore encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or data to be ensured and,
+more generally, to use and operate it in the same conditions as regards security.
+
+The fact that you are presently reading this means that you have had knowledge of the CeCILL-C
+license and that you accept its terms.*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include "computing_entity.hpp"
+
+/*
+====================================================================================================
+  ~*~ Philox4x32-10 ~*~
+  Counter-based generator from Salmon et al. (2011): each 128-bit block is a pure function of a key
+  and a counter. Streams derived from the same key with different counters never overlap, and any
+  position of any stream can be computed directly.
+==================================================================================================*/
+namespace philox {
+    using Block = std::array<uint32_t, 4>;
+
+    void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo) {
+        uint64_t product = uint64_t(a) * uint64_t(b);
+        hi = product >> 32;
+        lo = uint32_t(product);
+    }
+
+    // block number position of stream under key
+    Block block(uint64_t key, uint64_t stream, uint64_t position) {
+        Block c{{uint32_t(position), uint32_t(position >> 32), uint32_t(stream),
+            uint32_t(stream >> 32)}};
+        uint32_t k0 = uint32_t(key), k1 = uint32_t(key >> 32);
+        for (int round = 0; round < 10; round++) {
+            uint32_t hi0, lo0, hi1, lo1;
+            mulhilo(0xD2511F53, c[0], hi0, lo0);
+            mulhilo(0xCD9E8D57, c[2], hi1, lo1);
+            c = Block{{hi1 ^ c[1] ^ k0, lo1, hi0 ^ c[3] ^ k1, lo0}};
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+        return c;
+    }
+
+    // 53-bit double in [0, 1) from two 32-bit words
+    double to_double(uint32_t a, uint32_t b) {
+        return ((a >> 5) * 67108864.0 + (b >> 6)) * (1.0 / 9007199254740992.0);
+    }
+}  // namespace philox
+
+// splitmix64 finalizer, used to derive keys and stream numbers
+uint64_t mix_bits(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// key of a chain (several chains started from the same seed get independent keys)
+uint64_t chain_key(uint64_t seed, uint64_t chain = 0) {
+    return mix_bits(seed ^ mix_bits(chain));
+}
+
+// stream number associated to a name (e.g., the address of a move) independently of any ordering
+uint64_t stream_of(const std::string& name) {
+    uint64_t hash = 0xCBF29CE484222325ull;  // FNV-1a
+    for (unsigned char c : name) { hash = (hash ^ c) * 0x100000001B3ull; }
+    return mix_bits(hash);
+}
+
+/*
+====================================================================================================
+  ~*~ RandomStream ~*~
+  One stream of a Philox generator. Uniforms are generated in batches (two per block) into a small
+  buffer so that the hot path is a load and an increment. A default-constructed stream must be
+  seeded (see reset) before drawing from it, so that no two moves silently share a stream.
+==================================================================================================*/
+class RandomStream {
+    static constexpr int batch_size = 64;
+
+    uint64_t key{0}, stream{0}, position{0};
+    bool seeded{false};
+    std::array<double, batch_size> buffer;
+    int next{batch_size};
+
+    void refill() {
+        if (!seeded) { compoGM::p.fail("RandomStream: drawing from a stream that was not seeded"); }
+        for (int i = 0; i < batch_size; i += 2) {
+            auto b = philox::block(key, stream, position++);
+            buffer[i] = philox::to_double(b[0], b[1]);
+            buffer[i + 1] = philox::to_double(b[2], b[3]);
+        }
+        next = 0;
+    }
+
+  public:
+    using result_type = uint32_t;  // usable with std distributions
+
+    RandomStream() = default;
+    RandomStream(uint64_t key, uint64_t stream) : key(key), stream(stream), seeded(true) {}
+
+    void reset(uint64_t new_key, uint64_t new_stream) {
+        key = new_key;
+        stream = new_stream;
+        seeded = true;
+        position = 0;
+        next = batch_size;
+    }
+
+    double uniform() {
+        if (next == batch_size) { refill(); }
+        return buffer[next++];
+    }
+
+    bool decide(double prob) { return uniform() <= prob; }
+
+    // number of values drawn so far, and moving to a given position (e.g., to resume the stream
+    // in another process)
+    uint64_t tell() const { return position * 2 - (batch_size - next); }
+    void seek(uint64_t drawn) {
+        position = drawn / batch_size * (batch_size / 2);
+        refill();
+        next = drawn % batch_size;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+    result_type operator()() { return result_type(uniform() * 4294967296.0); }
+};
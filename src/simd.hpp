@@ -0,0 +1,146 @@
+/*Copyright or © or Copr. Centre National de la Recherche Scientifique (CNRS) (2018).
+Contributors:
+* Vincent LANORE - vincent.lanore@univ-lyon1.fr
+
+This software is a component-based library to write bayesian inference programs based on the
+graphical model.
+
+This software is governed by the CeCILL-C license under French law and abiding by the rules of
+distribution of free software. You can use, modify and/ or redistribute the software under the terms
+of the CeCILL-C license as circulated by CEA, CNRS and INRIA at the following URL
+"http:////www.cecill.info".
+
+As a counterpart to the access to the source code and rights to copy, modify and redistribute
+granted by the license, users are provided only with a limited warranty and the software's author,
+the holder of the economic rights, and the successive licensors have only limited liability.
+
+In this respect, the user's attention is drawn to the risks associated with loading, using,
+modifying and/or developing or reproducing the software by the user in light of its specific status
+of free software, that may mean that it is complicated to manipulate, and that also therefore means
+that it is reserved for developers and experienced professionals having in-depth computer knowledge.
+Users are therefore encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or data to be ensured and,
+more generally, to use and operate it in the same conditions as regards security.
+
+The fact that you are presently reading this means that you have had knowledge of the CeCILL-C
+license and that you accept its terms.*/
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+/*
+====================================================================================================
+  ~*~ SIMD helpers ~*~
+  Vectorized log and lgamma used by batch log densities (see distributions.hpp). The vector width
+  follows the instruction sets enabled by the compiler (-march=native in the Makefile): 8 doubles
+  with AVX-512, 4 with AVX2, and a scalar fallback on std::log and std::lgamma otherwise. Vectors
+  are GCC/clang vector extensions, which the compiler lowers to AVX2 or AVX-512 instructions.
+  Arguments must be strictly positive, finite and normal (distribution parameters and values).
+  Accuracy, measured against glibc on 2e6 arguments log-uniform in [1e-6, 1e8] (AVX2 and AVX-512
+  builds): log is within 1 ulp; lgamma is within 60 ulps where |lgamma(x)| > 0.5, and within 6e-14
+  in absolute value for x in [1e-6, 100]. On 1003 random terms, batch sums differ from sums of
+  scalar log probs by less than 5e-15 times the sum of absolute terms (see check_batch_log_probs
+  in test.cpp).
+==================================================================================================*/
+#if defined(__AVX512F__)
+#define COMPOGM_SIMD_WIDTH 8
+#elif defined(__AVX2__)
+#define COMPOGM_SIMD_WIDTH 4
+#else
+#define COMPOGM_SIMD_WIDTH 1
+#endif
+
+namespace simd {
+    const size_t width = COMPOGM_SIMD_WIDTH;
+
+#if COMPOGM_SIMD_WIDTH > 1
+    typedef double vd __attribute__((vector_size(8 * COMPOGM_SIMD_WIDTH)));
+    typedef long long vl __attribute__((vector_size(8 * COMPOGM_SIMD_WIDTH)));
+    typedef int vi __attribute__((vector_size(4 * COMPOGM_SIMD_WIDTH)));
+
+    vd broadcast(double a) { return vd{} + a; }
+
+    vd load(const double* ptr) {
+        vd result;
+        std::memcpy(&result, ptr, sizeof(vd));
+        return result;
+    }
+
+    vd load(const int* ptr) {
+        vi result;
+        std::memcpy(&result, ptr, sizeof(vi));
+        return __builtin_convertvector(result, vd);
+    }
+
+    double hsum(vd v) {
+        double result = 0;
+        for (size_t i = 0; i < width; i++) { result += v[i]; }
+        return result;
+    }
+
+    vd select(vl mask, vd a, vd b) { return (vd)((mask & (vl)a) | (~mask & (vl)b)); }
+
+    // natural logarithm (fdlibm algorithm)
+    vd log(vd x) {
+        const double sqrt2 = 1.41421356237309504880, ln2_hi = 6.93147180369123816490e-01,
+                     ln2_lo = 1.90821492927058770002e-10, lg1 = 6.666666666666735130e-01,
+                     lg2 = 3.999999999940941908e-01, lg3 = 2.857142874366239149e-01,
+                     lg4 = 2.222219843214978396e-01, lg5 = 1.818357216161805012e-01,
+                     lg6 = 1.531383769920937332e-01, lg7 = 1.479819860511658591e-01;
+        vl bits = (vl)x;
+        vl exponent = (bits >> 52) - 1023;
+        vd m = (vd)((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);  // m in [1, 2)
+        vl big = m > sqrt2;
+        m = select(big, m * 0.5, m);  // m in [sqrt2/2, sqrt2)
+        exponent -= big;              // big is -1 where true
+        vd k = __builtin_convertvector(exponent, vd);
+        vd f = m - 1.0;
+        vd s = f / (2.0 + f);
+        vd z = s * s;
+        vd w = z * z;
+        vd r = z * (lg1 + w * (lg3 + w * (lg5 + w * lg7))) + w * (lg2 + w * (lg4 + w * lg6));
+        vd hfsq = 0.5 * f * f;
+        return k * ln2_hi - ((hfsq - (s * (hfsq + r) + k * ln2_lo)) - f);
+    }
+
+    // log of the gamma function: recurrence up to 8, then the Stirling series
+    vd lgamma(vd x) {
+        vd z = x, prod = broadcast(1.0);
+        for (int i = 0; i < 8; i++) {
+            vl small = z < 8.0;
+            prod = select(small, prod * z, prod);
+            z = select(small, z + 1.0, z);
+        }
+        vd r = 1.0 / z;
+        vd r2 = r * r;
+        const double c1 = 1. / 12, c3 = -1. / 360, c5 = 1. / 1260, c7 = -1. / 1680,
+                     c9 = 1. / 1188, c11 = -691. / 360360, c13 = 1. / 156;  // Stirling coefficients
+        vd series = c9 + r2 * (c11 + r2 * c13);
+        series = r * (c1 + r2 * (c3 + r2 * (c5 + r2 * (c7 + r2 * series))));
+        return (z - 0.5) * log(z) - z + 0.91893853320467274178 + series - log(prod);
+    }
+#else
+    typedef double vd;
+
+    vd broadcast(double a) { return a; }
+    vd load(const double* ptr) { return *ptr; }
+    vd load(const int* ptr) { return *ptr; }
+    double hsum(vd v) { return v; }
+    vd log(vd x) { return std::log(x); }
+    vd lgamma(vd x) { return std::lgamma(x); }
+#endif
+
+    // sum of vector_body(i) over blocks of width elements and of scalar_body(i) over the rest
+    template <class VectorBody, class ScalarBody>
+    double reduce(size_t n, VectorBody vector_body, ScalarBody scalar_body) {
+        vd acc = broadcast(0.0);
+        size_t i = 0;
+        for (; i + width <= n; i += width) { acc += vector_body(i); }
+        double result = hsum(acc);
+        for (; i < n; i++) { result += scalar_body(i); }
+        return result;
+    }
+}  // namespace simd
@@ -0,0 +1,430 @@
+/*Copyright or © or Copr. Centre National de la Recherche Scientifique (CNRS) (2018).
+Contributors:
+* Vincent LANORE - vincent.lanore@univ-lyon1.fr
+
+This software is a component-based library to write bayesian inference programs based on the
+graphical model.
+
+This software is governed by the CeCILL-C license under French law and abiding by the rules of
+distribution of free software. You can use, modify and/ or redistribute the software under the terms
+of the CeCILL-C license as circulated by CEA, CNRS and INRIA at the following URL
+"http:////www.cecill.info".
+
+As a counterpart to the access to the source code and rights to copy, modify and redistribute
+granted by the license, users are provided only with a limited warranty and the software's author,
+the holder of the economic rights, and the successive licensors have only limited liability.
+
+In this respect, the user's attention is drawn to the risks associated with loading, using,
+modifying and/or developing or reproducing the software by the user in light of its specific status
+of free software, that may mean that it is complicated to manipulate, and that also therefore means
+that it is reserved for developers and experienced professionals having in-depth computer knowledge.
+Users are therefore encouraged to load and test the software's suitability as regards their
+requirements in conditions enabling the security of their systems and/or data to be ensured and,
+more generally, to use and operate it in the same conditions as regards security.
+
+The fact that you are presently reading this means that you have had knowledge of the CeCILL-C
+license and that you accept its terms.*/
+
+#pragma once
+
+#include <tinycompo.hpp>
+#include "arena.hpp"
+#include "interfaces.hpp"
+#include "mcmc_moves.hpp"
+#include "random.hpp"
+
+/*
+====================================================================================================
+  ~*~ Static model layer ~*~
+  Nodes whose parents have concrete types given as template parameters, and whose deterministic
+  functions are functors. Values, versions and log probs of parents are accessed through qualified
+  (non-virtual) calls, so the compiler can inline a whole chain of nodes, e.g., the log prob of a
+  Poisson node whose rate is a product of deterministic nodes. Static nodes are regular components
+  (they provide the same interfaces and ports as dynamic nodes) and can be mixed with dynamic nodes,
+  which can also be used as parent types (e.g., OrphanNode or Constant).
+==================================================================================================*/
+
+// distribution of static nodes (lets the rest of the library recognize static nodes as nodes of a
+// given distribution, e.g., for Gibbs moves, suffstats or sibling groups)
+template <class PDS>
+struct StaticUnaryOf {
+    virtual ~StaticUnaryOf() = default;
+};
+
+template <class PDS>
+struct StaticBinaryOf {
+    virtual ~StaticBinaryOf() = default;
+};
+
+// link to a parent of concrete type P (checked when the port is set)
+template <class P>
+class StaticParent {
+    P* ptr{nullptr};
+
+  public:
+    void set(Value<double>* value) {
+        ptr = dynamic_cast<P*>(value);
+        if (ptr == nullptr) { compoGM::p.fail("Static node: parent does not have expected type"); }
+    }
+    double value() const { return ptr->P::get_ref(); }
+    size_t version() const { return ptr->P::get_version(); }
+};
+
+/*
+====================================================================================================
+  ~*~ Static deterministic nodes ~*~
+  The value is recomputed when the sum of the versions of the parents has changed (versions never
+  decrease so the sum changes as soon as one of them does).
+==================================================================================================*/
+class StaticDeterministicNode : public Value<double>,
+                                public Versioned,
+                                public Cached,
+                                public tc::Component,
+                                public ArenaAllocated {
+  protected:
+    mutable double x{0};
+    mutable size_t version{0};
+    mutable size_t seen{size_t(-1)};  // sum of the versions of parents at last computation
+};
+
+template <class F, class A>
+class StaticDeterministicUnaryNode : public StaticDeterministicNode {
+    StaticParent<A> a;
+    void set_a(Value<double>* ptr) { a.set(ptr); }
+
+    void refresh() const {
+        size_t parent_version = a.version();
+        if (parent_version != seen) {
+            seen = parent_version;
+            x = F()(a.value());
+            version++;
+        }
+    }
+
+  public:
+    StaticDeterministicUnaryNode() { port("a", &StaticDeterministicUnaryNode::set_a); }
+
+    double& get_ref() final {
+        refresh();
+        return x;
+    }
+    const double& get_ref() const final {
+        refresh();
+        return x;
+    }
+    size_t get_version() const final {
+        refresh();
+        return version;
+    }
+    void bump_version() final { version++; }
+    std::string debug() const final {
+        return "StaticDeterministicUnaryNode [" + std::to_string(get_ref()) + "]";
+    }
+};
+
+template <class F, class A, class B, class C>
+class StaticDeterministicTernaryNode : public StaticDeterministicNode {
+    StaticParent<A> a;
+    StaticParent<B> b;
+    StaticParent<C> c;
+    void set_a(Value<double>* ptr) { a.set(ptr); }
+    void set_b(Value<double>* ptr) { b.set(ptr); }
+    void set_c(Value<double>* ptr) { c.set(ptr); }
+
+    void refresh() const {
+        size_t parent_version = a.version() + b.version() + c.version();
+        if (parent_version != seen) {
+            seen = parent_version;
+            x = F()(a.value(), b.value(), c.value());
+            version++;
+        }
+    }
+
+  public:
+    StaticDeterministicTernaryNode() {
+        port("a", &StaticDeterministicTernaryNode::set_a);
+        port("b", &StaticDeterministicTernaryNode::set_b);
+        port("c", &StaticDeterministicTernaryNode::set_c);
+    }
+
+    double& get_ref() final {
+        refresh();
+        return x;
+    }
+    const double& get_ref() const final {
+        refresh();
+        return x;
+    }
+    size_t get_version() const final {
+        refresh();
+        return version;
+    }
+    void bump_version() final { version++; }
+    std::string debug() const final {
+        return "StaticDeterministicTernaryNode [" + std::to_string(get_ref()) + "]";
+    }
+};
+
+template <class A>
+class StaticMean : public StaticDeterministicNode {
+    std::vector<StaticParent<A>> parents;
+    void add_parent(Value<double>* ptr) {
+        parents.emplace_back();
+        parents.back().set(ptr);
+    }
+
+    void refresh() const {
+        size_t parent_version = 0;
+        for (auto& p : parents) { parent_version += p.version(); }
+        if (parent_version != seen) {
+            seen = parent_version;
+            double sum = 0;
+            for (auto& p : parents) { sum += p.value(); }
+            x = sum / parents.size();
+            version++;
+        }
+    }
+
+  public:
+    StaticMean() { port("parent", &StaticMean::add_parent); }
+
+    double& get_ref() final {
+        refresh();
+        return x;
+    }
+    const double& get_ref() const final {
+        refresh();
+        return x;
+    }
+    size_t get_version() const final {
+        refresh();
+        return version;
+    }
+    void bump_version() final { version++; }
+    std::string debug() const final { return "StaticMean [" + std::to_string(get_ref()) + "]"; }
+};
+
+struct Power10Function {
+    double operator()(double a) const { return pow(10, a); }
+};
+
+struct InversePower10Function {
+    double operator()(double a) const { return 1. / double(pow(10, a)); }
+};
+
+struct ProductFunction {
+    double operator()(double a, double b, double c) const { return a * b * c; }
+};
+
+// product of its three parents (recognized as such by conjugate updates, see ProductOfParents)
+template <class A, class B, class C>
+class StaticProduct : public StaticDeterministicTernaryNode<ProductFunction, A, B, C>,
+                      public ProductOfParents {};
+
+/*
+====================================================================================================
+  ~*~ Static probabilistic nodes ~*~
+  Static counterparts of UnaryNode and BinaryNode.
+==================================================================================================*/
+template <class PDS, class A>
+class StaticUnaryNode : public Value<typename PDS::ValueType>,
+                        public LogProb,
+                        public Backup,
+                        public Versioned,
+                        public VersionedLogProb,
+                        public StaticUnaryOf<PDS>,
+                        public tc::Component,
+                        public ArenaAllocated {
+    using ValueType = typename PDS::ValueType;
+    ValueType value{0};
+    ValueType bk_value{0};
+    size_t version{0};
+    StaticParent<A> a;
+    void set_a(Value<double>* ptr) { a.set(ptr); }
+
+  public:
+    StaticUnaryNode(ValueType value) : value(value) {
+        port("x", &StaticUnaryNode::value);
+        port("a", &StaticUnaryNode::set_a);
+    }
+    ValueType& get_ref() final { return value; }
+    const ValueType& get_ref() const final { return value; }
+    double get_log_prob() final { return PDS::full_log_prob(value, a.value()); }
+    double get_log_prob_x() final { return PDS::partial_log_prob_x(value, a.value()); }
+    double get_log_prob_a() final { return PDS::partial_log_prob_a(value, a.value()); }
+    void backup() final {
+        bk_value = value;
+        version++;
+    }
+    void restore() final {
+        value = bk_value;
+        version++;
+    }
+    size_t get_version() const final { return version; }
+    void bump_version() final { version++; }
+    size_t get_log_prob_version() const final { return version + a.version(); }
+    std::string debug() const final { return "StaticUnaryNode [" + std::to_string(value) + "]"; }
+};
+
+template <class PDS, class A, class B>
+class StaticBinaryNode : public Value<typename PDS::ValueType>,
+                         public LogProb,
+                         public Backup,
+                         public Versioned,
+                         public VersionedLogProb,
+                         public StaticBinaryOf<PDS>,
+                         public tc::Component,
+                         public ArenaAllocated {
+    using ValueType = typename PDS::ValueType;
+    ValueType value{0};
+    ValueType bk_value{0};
+    size_t version{0};
+    StaticParent<A> a;
+    StaticParent<B> b;
+    void set_a(Value<double>* ptr) { a.set(ptr); }
+    void set_b(Value<double>* ptr) { b.set(ptr); }
+
+  public:
+    StaticBinaryNode(ValueType value) : value(value) {
+        port("x", &StaticBinaryNode::value);
+        port("a", &StaticBinaryNode::set_a);
+        port("b", &StaticBinaryNode::set_b);
+    }
+    ValueType& get_ref() final { return value; }
+    const ValueType& get_ref() const final { return value; }
+    double get_log_prob() final { return PDS::full_log_prob(value, a.value(), b.value()); }
+    double get_log_prob_x() final { return PDS::partial_log_prob_x(value, a.value(), b.value()); }
+    double get_log_prob_a() final { return PDS::partial_log_prob_a(value, a.value(), b.value()); }
+    double get_log_prob_b() final { return PDS::partial_log_prob_b(value, a.value(), b.value()); }
+    void backup() final {
+        bk_value = value;
+        version++;
+    }
+    void restore() final {
+        value = bk_value;
+        version++;
+    }
+    size_t get_version() const final { return version; }
+    void bump_version() final { version++; }
+    size_t get_log_prob_version() const final { return version + a.version() + b.version(); }
+    std::string debug() const final { return "StaticBinaryNode [" + std::to_string(value) + "]"; }
+};
+
+/*
+====================================================================================================
+  ~*~ StaticBlanket ~*~
+  Log prob terms of a move sorted by concrete node type (and direction) so that the blanket log prob
+  is a sequence of loops over inlined log prob computations. Terms of other types (e.g., sibling
+  groups or suffstats) are kept as dynamic selectors.
+==================================================================================================*/
+template <class... Nodes>
+struct StaticBlanket;
+
+template <>
+struct StaticBlanket<> {
+    std::vector<LogProbSelector> others;
+
+    void add(LogProbSelector selector) { others.push_back(selector); }
+
+    double log_prob() {
+        double result = 0;
+        for (auto& s : others) { result += s.get_log_prob(); }
+        return result;
+    }
+};
+
+template <class Node, class... Nodes>
+struct StaticBlanket<Node, Nodes...> : StaticBlanket<Nodes...> {
+    std::vector<Node*> x, a, b, full;  // nodes by direction
+
+    void add(LogProbSelector selector) {
+        auto ptr = dynamic_cast<Node*>(selector.get_ptr());
+        if (ptr == nullptr) {
+            StaticBlanket<Nodes...>::add(selector);
+            return;
+        }
+        switch (selector.get_direction()) {
+            case LogProbSelector::X: x.push_back(ptr); break;
+            case LogProbSelector::A: a.push_back(ptr); break;
+            case LogProbSelector::B: b.push_back(ptr); break;
+            default: full.push_back(ptr);
+        }
+    }
+
+    double log_prob() {
+        double result = StaticBlanket<Nodes...>::log_prob();
+        for (auto n : x) { result += n->Node::get_log_prob_x(); }
+        for (auto n : a) { result += n->Node::get_log_prob_a(); }
+        for (auto n : b) { result += n->Node::get_log_prob_b(); }
+        for (auto n : full) { result += n->Node::get_log_prob(); }
+        return result;
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ StaticMHMove ~*~
+  Same as SimpleMHMove for a target of concrete type Target whose blanket contains nodes of types
+  Children. Connected like SimpleMHMove (see ConnectMove) and declared with MCMC::move<...>.
+==================================================================================================*/
+template <class M, class Target, class... Children>
+class StaticMHMove : public Move, public tc::Component, public ArenaAllocated {
+    Target* target{nullptr};
+    void set_target(Value<double>* ptr) {
+        target = dynamic_cast<Target*>(ptr);
+        if (target == nullptr) { compoGM::p.fail("StaticMHMove: target has unexpected type"); }
+    }
+    void set_target_backup(Backup*) {}  // backup goes through target directly
+
+    StaticBlanket<Target, Children...> blanket;
+    void add_log_prob(LogProbSelector selector) { blanket.add(selector); }
+    ChangeSubscribers subscribers;  // notified every time the target changes
+    void add_subscription(ChangeSubscription s) { subscribers.add(s); }
+
+    RandomStream rng;
+    AdaptiveTuning adaptive_tuning;
+
+    bool mh_step(double tuning) {
+        double log_prob_before = blanket.log_prob();
+        target->Target::backup();
+        double log_hastings = M::move(target->Target::get_ref(), tuning, rng);
+        subscribers.notify();
+        double log_prob_after = blanket.log_prob();
+        bool accept = rng.decide(exp(log_prob_after - log_prob_before + log_hastings));
+        if (not accept) {
+            target->Target::restore();
+            subscribers.notify();
+        }
+        return accept;
+    }
+
+  public:
+    StaticMHMove() {
+        port("target", &StaticMHMove::set_target);
+        port("targetbackup", &StaticMHMove::set_target_backup);
+        port("logprob", &StaticMHMove::add_log_prob);
+        port("changes", &StaticMHMove::add_subscription);
+    }
+
+    void move(double tuning = 1.0) final { mh_step(tuning); }
+
+    bool tunable() const final { return true; }
+
+    void adaptive_move(bool adapt) final {
+        bool accept = mh_step(adaptive_tuning.get());
+        if (adapt) { adaptive_tuning.update(accept); }
+    }
+
+    void seed(uint64_t key, uint64_t stream) final { rng.reset(key, stream); }
+
+    std::vector<double> get_state() const final {
+        std::vector<double> state{double(rng.tell())};
+        adaptive_tuning.save(state);
+        return state;
+    }
+
+    void set_state(const std::vector<double>& state) final {
+        rng.seek(uint64_t(state.at(0)));
+        adaptive_tuning.load(&state.at(1));
+    }
+};
@@ -27,10 +27,221 @@ license and that you accept its terms.*/
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <deque>
+#include <random>
+#include "arena.hpp"
 #include "interfaces.hpp"
+#include "random.hpp"
 #include "tinycompo.hpp"
 
+/*
+====================================================================================================
+  ~*~ Dirty list ~*~
+  Entries marked as changed since the list was last drained, each listed once however many times
+  it was marked. Marking is thread-safe (moves performed in parallel may notify entries of the same
+  suffstat); draining is not.
+==================================================================================================*/
+class DirtyList {
+    std::deque<std::atomic<bool>> marked;
+    std::vector<size_t> entries;  // marked entries are in the first nb_entries positions
+    std::atomic<size_t> nb_entries{0};
+
+  public:
+    void add() {
+        marked.emplace_back(false);
+        entries.push_back(0);
+    }
+
+    void mark(size_t entry) {
+        if (!marked[entry].exchange(true)) { entries[nb_entries++] = entry; }
+    }
+
+    template <class F>
+    void drain(F f) {
+        size_t nb = nb_entries;
+        for (size_t i = 0; i < nb; i++) {
+            marked[entries[i]] = false;
+            f(entries[i]);
+        }
+        nb_entries = 0;
+    }
+
+    void clear() {
+        drain([](size_t) {});
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ Incremental sums ~*~
+  Sum (and optionally sum of logs) of a set of values. Watched values are only read again when
+  they are notified as changed (see Changes interface), other values when their version changed;
+  sums are then corrected by the difference. Sums are recomputed from scratch every
+  recompute_period updates to bound floating point drift.
+==================================================================================================*/
+template <class ValueType, bool with_log>
+class IncrementalSums {
+    struct Entry {
+        Value<ValueType>* value;
+        const Versioned* versioned;
+        size_t version;
+        ValueType x;
+        double log_x;
+    };
+    std::vector<Entry> entries;
+    std::vector<bool> watched;
+    std::vector<size_t> unwatched;  // positions of entries that are not watched
+    DirtyList dirty;
+    int nb_updates{0};
+
+    // returns true if the value has changed
+    bool update_entry(Entry& e) {
+        e.version = version_of(e.versioned);
+        ValueType x = e.value->get_ref();
+        if (x == e.x) { return false; }
+        double log_x = with_log ? log(x) : 0;
+        sum += x - e.x;
+        sum_log += log_x - e.log_x;
+        e.x = x;
+        e.log_x = log_x;
+        return true;
+    }
+
+    // returns true if recomputed sums differ from the previous ones
+    bool recompute() {
+        double new_sum = 0, new_sum_log = 0;
+        unwatched.clear();
+        for (size_t i = 0; i < entries.size(); i++) {
+            auto& e = entries[i];
+            e.version = version_of(e.versioned);
+            e.x = e.value->get_ref();
+            e.log_x = with_log ? log(e.x) : 0;
+            new_sum += e.x;
+            new_sum_log += e.log_x;
+            if (!watched[i]) { unwatched.push_back(i); }
+        }
+        dirty.clear();
+        bool changed = new_sum != sum or new_sum_log != sum_log;
+        sum = new_sum;
+        sum_log = new_sum_log;
+        return changed;
+    }
+
+  public:
+    using Input = Value<ValueType>;
+    static constexpr int recompute_period = 100;
+    double sum{0}, sum_log{0};
+
+    void add(Value<ValueType>* p) {
+        entries.push_back({p, dynamic_cast<const Versioned*>(p), 0, 0, 0});
+        watched.push_back(false);
+        dirty.add();
+        nb_updates = 0;  // next update is a full recompute
+    }
+
+    // changes of the entry are notified through changed (e.g., all moves changing it notify it)
+    void watch(size_t entry) {
+        watched.at(entry) = true;
+        nb_updates = 0;
+    }
+
+    void changed(size_t entry) { dirty.mark(entry); }
+
+    void reset() { nb_updates = 0; }
+
+    size_t size() const { return entries.size(); }
+
+    // returns true if sums have changed
+    bool update() {
+        if (nb_updates++ % recompute_period == 0) { return recompute(); }
+        bool changed = false;
+        for (auto i : unwatched) {
+            auto& e = entries[i];
+            if (version_of(e.versioned) != e.version) { changed |= update_entry(e); }
+        }
+        dirty.drain([&](size_t i) { changed |= update_entry(entries[i]); });
+        return changed;
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ Dense sums ~*~
+  Same as IncrementalSums for cells of a same dense storage (see dense_arrays.hpp): values and
+  versions are read from the storage at the positions of the cells, in increasing order, without
+  going through the cells.
+==================================================================================================*/
+template <class Cell, bool with_log>
+class DenseSums {
+    using Storage = typename Cell::Storage;
+    using ValueType = typename Cell::ValueType;
+    const Storage* storage{nullptr};
+    std::vector<size_t> positions;  // increasing
+    std::vector<size_t> versions;   // versions of the cells when last read
+    std::vector<ValueType> xs;
+    std::vector<double> log_xs;
+    int nb_updates{0};
+
+    bool recompute() {
+        double new_sum = 0, new_sum_log = 0;
+        for (size_t k = 0; k < positions.size(); k++) {
+            auto i = positions[k];
+            versions[k] = storage->versions[i];
+            xs[k] = storage->values[i];
+            log_xs[k] = with_log ? log(xs[k]) : 0;
+            new_sum += xs[k];
+            new_sum_log += log_xs[k];
+        }
+        bool changed = new_sum != sum or new_sum_log != sum_log;
+        sum = new_sum;
+        sum_log = new_sum_log;
+        return changed;
+    }
+
+  public:
+    using Input = Cell;
+    static constexpr int recompute_period = 100;
+    double sum{0}, sum_log{0};
+
+    void add(Cell* cell) {
+        if (storage == nullptr) { storage = &cell->dense_storage(); }
+        if (storage != &cell->dense_storage()) {
+            compoGM::p.fail("DenseSums: cells do not belong to the same dense storage");
+        }
+        auto it = std::upper_bound(positions.begin(), positions.end(), cell->position());
+        positions.insert(it, cell->position());
+        versions.push_back(0);
+        xs.push_back(0);
+        log_xs.push_back(0);
+        nb_updates = 0;  // next update is a full recompute
+    }
+
+    size_t size() const { return positions.size(); }
+
+    // returns true if sums have changed
+    bool update() {
+        if (nb_updates++ % recompute_period == 0) { return recompute(); }
+        bool changed = false;
+        for (size_t k = 0; k < positions.size(); k++) {
+            auto i = positions[k];
+            if (storage->versions[i] == versions[k]) { continue; }
+            versions[k] = storage->versions[i];
+            ValueType x = storage->values[i];
+            if (x == xs[k]) { continue; }
+            double log_x = with_log ? log(x) : 0;
+            sum += x - xs[k];
+            sum_log += log_x - log_xs[k];
+            xs[k] = x;
+            log_xs[k] = log_x;
+            changed = true;
+        }
+        return changed;
+    }
+};
+
 /*
 ====================================================================================================
   ~*~ Gamma Suff Stat ~*~
@@ -40,8 +251,9 @@ struct GammaShapeScaleSSFormula {
         return -N * std::lgamma(k) - N * k * log(theta) + (k - 1) * sum_log - (1 / theta) * sum;
     }
 
-    static double partial_log_prob_a(double k, double, int N, double, double sum_log) {  // a = k
-        return -N * std::lgamma(k) + (k - 1) * sum_log;
+    static double partial_log_prob_a(double k, double theta, int N, double,
+        double sum_log) {  // a = k
+        return -N * std::lgamma(k) - N * k * log(theta) + (k - 1) * sum_log;
     }
 
     static double partial_log_prob_b(double k, double theta, int N, double sum,
@@ -66,48 +278,90 @@ struct GammaShapeRateSSFormula {
     }
 };
 
+struct PoissonSSFormula {  // log factorials of values are left out (they only depend on values)
+    static double full_log_prob(double lambda, double, int N, double sum, double) {
+        return -N * lambda + log(lambda) * sum;
+    }
+
+    static double partial_log_prob_a(double lambda, double b, int N, double sum, double sum_log) {
+        return full_log_prob(lambda, b, N, sum, sum_log);
+    }
+
+    static double partial_log_prob_b(double, double, int, double, double) { return 0; }
+};
+
+struct ExponentialSSFormula {
+    static double full_log_prob(double lambda, double, int N, double sum, double) {
+        return N * log(lambda) - lambda * sum;
+    }
+
+    static double partial_log_prob_a(double lambda, double b, int N, double sum, double sum_log) {
+        return full_log_prob(lambda, b, N, sum, sum_log);
+    }
+
+    static double partial_log_prob_b(double, double, int, double, double) { return 0; }
+};
+
 template <class Formula>
-class GammaSSTemplate : public tc::Component, public LogProb, public Proxy {
-    std::vector<Value<double>*> values;
-    void add_value(Value<double>* p) { values.push_back(p); }
+class GammaSSTemplate : public tc::Component,
+                        public LogProb,
+                        public VersionedLogProb,
+                        public Proxy,
+                        public Changes,
+                        public ArenaAllocated {
+    IncrementalSums<double, true> values;
+    void add_value(Value<double>* p) { values.add(p); }
+    void watch(size_t entry) { values.watch(entry); }
 
     Value<double>* a_;
     Value<double>* b_;
-    double sum{0};
-    double sum_log{0};
+    const Versioned* a_version{nullptr};
+    const Versioned* b_version{nullptr};
+    void set_a(Value<double>* p) {
+        a_ = p;
+        a_version = dynamic_cast<const Versioned*>(p);
+    }
+    void set_b(Value<double>* p) {
+        b_ = p;
+        b_version = dynamic_cast<const Versioned*>(p);
+    }
+
+    size_t version{0};  // changes every time the sums change
 
   public:
     GammaSSTemplate() {
         port("values", &GammaSSTemplate::add_value);
-        port("a", &GammaSSTemplate::a_);
-        port("b", &GammaSSTemplate::b_);
+        port("a", &GammaSSTemplate::set_a);
+        port("b", &GammaSSTemplate::set_b);
+        port("watched", &GammaSSTemplate::watch);
     }
 
+    void changed(size_t entry) final { values.changed(entry); }
+    void reset() final { values.reset(); }
+
     void acquire() final {
-        for (auto p : values) {
-            auto value = p->get_ref();
-            sum += value;
-            sum_log += log(value);
-        }
+        if (values.update()) { version++; }
     }
 
-    void release() final {
-        sum = 0;
-        sum_log = 0;
+    void release() final {}  // sums are kept for the next (incremental) acquire
+
+    size_t get_log_prob_version() const final {
+        return version + version_of(a_version) + version_of(b_version);
     }
 
     double get_log_prob() final {
-        return Formula::full_log_prob(a_->get_ref(), b_->get_ref(), values.size(), sum, sum_log);
+        return Formula::full_log_prob(
+            a_->get_ref(), b_->get_ref(), values.size(), values.sum, values.sum_log);
     }
 
     double get_log_prob_a() final {  // a = k
         return Formula::partial_log_prob_a(
-            a_->get_ref(), b_->get_ref(), values.size(), sum, sum_log);
+            a_->get_ref(), b_->get_ref(), values.size(), values.sum, values.sum_log);
     }
 
     double get_log_prob_b() final {  // b = theta
         return Formula::partial_log_prob_b(
-            a_->get_ref(), b_->get_ref(), values.size(), sum, sum_log);
+            a_->get_ref(), b_->get_ref(), values.size(), values.sum, values.sum_log);
     }
 };
 
@@ -118,32 +372,350 @@ using GammaShapeScaleSuffstat = GammaSSTemplate<GammaShapeScaleSSFormula>;
 ====================================================================================================
   ~*~ Poisson Suff Stat ~*~
 ==================================================================================================*/
-class PoissonSuffstat : public tc::Component, public LogProb, public Proxy {
-    std::vector<Value<int>*> values;
-    void add_value(Value<int>* p) { values.push_back(p); }
+class PoissonSuffstat : public tc::Component,
+                        public LogProb,
+                        public VersionedLogProb,
+                        public Proxy,
+                        public Changes,
+                        public ArenaAllocated {
+    IncrementalSums<int, false> values;
+    void add_value(Value<int>* p) { values.add(p); }
+    void watch(size_t entry) { values.watch(entry); }
 
     Value<double>* lambda_;
-    double sum{0};
+    const Versioned* lambda_version{nullptr};
+    void set_lambda(Value<double>* p) {
+        lambda_ = p;
+        lambda_version = dynamic_cast<const Versioned*>(p);
+    }
+
+    size_t version{0};  // changes every time the sum changes
 
   public:
     PoissonSuffstat() {
         port("values", &PoissonSuffstat::add_value);
-        port("lambda", &PoissonSuffstat::lambda_);
+        port("a", &PoissonSuffstat::set_lambda);  // same port name as Poisson nodes
+        port("watched", &PoissonSuffstat::watch);
     }
 
+    void changed(size_t entry) final { values.changed(entry); }
+    void reset() final { values.reset(); }
+
     void acquire() final {
-        sum = 0;
-        for (auto p : values) {
-            auto value = p->get_ref();
-            sum += value;
-        }
+        if (values.update()) { version++; }
     }
 
     void release() final {}
 
+    size_t get_log_prob_version() const final { return version + version_of(lambda_version); }
+
     double get_log_prob() final {  // a = lambda
-        int N = values.size();
-        double lambda = lambda_->get_ref();
-        return -N * lambda + log(lambda) * sum;
+        return PoissonSSFormula::full_log_prob(lambda_->get_ref(), 0, values.size(), values.sum, 0);
     }
 };
+
+/*
+====================================================================================================
+  ~*~ Conjugate updates ~*~
+  Full conditionals in closed form, computed from the sufficient statistics of the children of a
+  variable. Each child comes with the parameter it needs (e.g., the rate of a Poisson child). Used
+  by GibbsMove and DenseGibbsMove (children are passed as ranges).
+==================================================================================================*/
+template <class T>
+struct ConjugateChild {
+    using ValueType = T;
+    Value<ValueType>* x;
+    Value<double>* parameter;
+};
+
+// child of the cell at position in a dense storage (see DenseGibbsMove)
+template <class Child>
+struct DenseConjugateChild {
+    size_t position;
+    Child child;
+};
+
+struct GammaShapeScalePrior {
+    static double rate(double, double theta) { return 1 / theta; }
+};
+
+struct GammaShapeRatePrior {
+    static double rate(double, double beta) { return beta; }
+};
+
+// Gamma prior, Poisson children with rates proportional to the target (e.g., rate = c * target,
+// through product nodes, see GMIndex::proportional)
+template <class Prior>
+struct GammaPoissonConjugacy {
+    using Child = ConjugateChild<int>;
+    static std::string parameter_port() { return "a"; }  // rate
+    template <class Index>
+    static bool valid_child(
+        const Index& index, const std::string& child, const std::string& target) {
+        auto& parents = index.port_parents_of(child);
+        return index.poisson(child) and parents.count("a") > 0 and
+               index.proportional(parents.at("a"), target);
+    }
+
+    static double draw(
+        double x, double a, double b, const Child* begin, const Child* end, RandomStream& rng) {
+        double sum{0}, sum_factors{0};
+        for (auto c = begin; c != end; c++) {
+            sum += c->x->get_ref();
+            sum_factors += c->parameter->get_ref() / x;
+        }
+        double shape = a + sum;
+        double rate = Prior::rate(a, b) + sum_factors;
+        return std::gamma_distribution<double>(shape, 1 / rate)(rng);
+    }
+};
+
+using GammaShapeScalePoissonConjugacy = GammaPoissonConjugacy<GammaShapeScalePrior>;
+using GammaShapeRatePoissonConjugacy = GammaPoissonConjugacy<GammaShapeRatePrior>;
+
+// Normal prior (mean a, std dev b), Normal children whose mean is the target
+struct NormalNormalConjugacy {
+    using Child = ConjugateChild<double>;
+    static std::string parameter_port() { return "b"; }  // std dev
+    template <class Index>
+    static bool valid_child(
+        const Index& index, const std::string& child, const std::string& target) {
+        auto& parents = index.port_parents_of(child);
+        return index.normal(child) and parents.count("a") > 0 and parents.at("a") == target and
+               parents.count("b") > 0;
+    }
+
+    static double draw(
+        double, double mu, double sigma, const Child* begin, const Child* end, RandomStream& rng) {
+        double precision = 1 / (sigma * sigma);
+        double weighted_sum = mu * precision;
+        for (auto c = begin; c != end; c++) {
+            double s = c->parameter->get_ref();
+            precision += 1 / (s * s);
+            weighted_sum += c->x->get_ref() / (s * s);
+        }
+        return std::normal_distribution<double>(weighted_sum / precision, 1 / sqrt(precision))(rng);
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ Normal Suff Stat ~*~
+  Normal nodes with their own means (port values, and port means in the same order) and a shared
+  std dev (port b). Squared deviations are kept per element. Acquire re-reads the elements whose
+  value or mean was notified as changed (see Changes interface) or, for elements that are not
+  watched, whose versions changed. Between acquisitions, only notified elements are updated (e.g.,
+  when a move changes means), so moves that only change the std dev do no work per element.
+==================================================================================================*/
+class NormalSuffstat : public tc::Component,
+                       public LogProb,
+                       public VersionedLogProb,
+                       public Proxy,
+                       public Changes,
+                       public ArenaAllocated {
+    struct Entry {
+        Value<double>* x;
+        Value<double>* mean;
+        const Versioned* x_version;
+        const Versioned* mean_version;
+        size_t seen_x, seen_mean;
+        double deviation;
+    };
+    // Notified changes are applied when the log prob or its version is requested, hence the
+    // mutable fields (entries, dirty, sum_deviations, version). This is safe as long as no two
+    // readers run at once: moves reading a suffstat read all its inputs (see suffstat_reads in
+    // mcmc.hpp) and each of them writes one of these inputs (its target, or a cached deterministic
+    // node in between), so the coloring never puts two of them, or a reader and a move notifying
+    // an entry, in the same color. Notifications themselves only mark entries (atomically).
+    mutable std::vector<Entry> entries;
+    size_t nb_means{0};
+    void add_value(Value<double>* p) {
+        entries.push_back({p, nullptr, dynamic_cast<const Versioned*>(p), nullptr, 0, 0, 0});
+        watched.push_back(false);
+        dirty.add();
+        nb_acquires = 0;
+    }
+    void add_mean(Value<double>* p) {
+        auto& e = entries.at(nb_means++);
+        e.mean = p;
+        e.mean_version = dynamic_cast<const Versioned*>(p);
+    }
+    void watch(size_t entry) {
+        watched.at(entry) = true;
+        nb_acquires = 0;
+    }
+
+    Value<double>* b_;
+    const Versioned* b_version{nullptr};
+    void set_b(Value<double>* p) {
+        b_ = p;
+        b_version = dynamic_cast<const Versioned*>(p);
+    }
+
+    std::vector<bool> watched;
+    std::vector<size_t> unwatched;  // positions of entries that are not watched
+    mutable DirtyList dirty;
+
+    static constexpr int recompute_period = 100;
+    mutable double sum_deviations{0};  // sum of (x - mean)^2
+    mutable size_t version{0};         // changes every time sum_deviations changes
+    int nb_acquires{0};
+
+    // returns true if the squared deviation has changed
+    bool update_entry(Entry& e) const {
+        e.seen_x = version_of(e.x_version);
+        e.seen_mean = version_of(e.mean_version);
+        double d = e.x->get_ref() - e.mean->get_ref();
+        double deviation = d * d;
+        if (deviation == e.deviation) { return false; }
+        sum_deviations += deviation - e.deviation;
+        e.deviation = deviation;
+        return true;
+    }
+
+    void recompute() {
+        double previous_sum = sum_deviations, new_sum = 0;
+        unwatched.clear();
+        for (size_t i = 0; i < entries.size(); i++) {
+            update_entry(entries[i]);
+            new_sum += entries[i].deviation;
+            if (!watched[i]) { unwatched.push_back(i); }
+        }
+        dirty.clear();
+        if (new_sum != previous_sum) { version++; }
+        sum_deviations = new_sum;
+    }
+
+    void apply_changes() const {
+        bool changed = false;
+        dirty.drain([&](size_t i) { changed |= update_entry(entries[i]); });
+        if (changed) { version++; }
+    }
+
+  public:
+    NormalSuffstat() {
+        port("values", &NormalSuffstat::add_value);
+        port("means", &NormalSuffstat::add_mean);
+        port("b", &NormalSuffstat::set_b);
+        port("watched", &NormalSuffstat::watch);
+    }
+
+    void acquire() final {
+        if (nb_acquires++ % recompute_period == 0) { return recompute(); }
+        bool changed = false;
+        for (auto i : unwatched) {
+            auto& e = entries[i];
+            if (version_of(e.x_version) != e.seen_x or version_of(e.mean_version) != e.seen_mean) {
+                changed |= update_entry(e);
+            }
+        }
+        if (changed) { version++; }
+        apply_changes();
+    }
+
+    void release() final {}
+
+    void changed(size_t entry) final { dirty.mark(entry); }
+    void reset() final { nb_acquires = 0; }
+
+    size_t get_log_prob_version() const final {
+        apply_changes();  // means may have changed since acquire
+        return version + version_of(b_version);
+    }
+
+    double get_log_prob() final { return get_log_prob_b() - 0.5 * entries.size() * log(2 * M_PI); }
+
+    double get_log_prob_a() final {  // a = means
+        apply_changes();
+        double sigma = b_->get_ref();
+        return -sum_deviations / (2 * sigma * sigma);
+    }
+
+    double get_log_prob_b() final {  // b = sigma
+        apply_changes();
+        double sigma = b_->get_ref();
+        return -sum_deviations / (2 * sigma * sigma) - entries.size() * log(sigma);
+    }
+};
+
+/*
+====================================================================================================
+  ~*~ Sibling group ~*~
+  Log prob of several nodes with the same distribution and the same parents, computed like a
+  suffstat so that parameter-only terms are evaluated once for the whole group. Sums are refreshed
+  (from values whose version changed) whenever they are needed, so no acquire/release is required.
+  Sums are IncrementalSums on values, or DenseSums when siblings are cells of a same dense storage.
+  Created by ConnectIndividualMove for groups of siblings in the blanket of a move.
+==================================================================================================*/
+template <class Formula, class Sums>
+class SiblingGroup : public tc::Component,
+                     public LogProb,
+                     public VersionedLogProb,
+                     public ArenaAllocated {
+    mutable Sums values;
+    void add_value(typename Sums::Input* p) { values.add(p); }
+
+    Value<double>* a_{nullptr};
+    Value<double>* b_{nullptr};  // unused for one-parameter distributions
+    const Versioned* a_version{nullptr};
+    const Versioned* b_version{nullptr};
+    void set_a(Value<double>* p) {
+        a_ = p;
+        a_version = dynamic_cast<const Versioned*>(p);
+    }
+    void set_b(Value<double>* p) {
+        b_ = p;
+        b_version = dynamic_cast<const Versioned*>(p);
+    }
+
+    mutable size_t version{0};  // changes every time the sums change
+    void refresh() const {
+        if (values.update()) { version++; }
+    }
+
+    double a() const { return a_->get_ref(); }
+    double b() const { return (b_ != nullptr) ? b_->get_ref() : 0; }
+
+  public:
+    SiblingGroup() {
+        port("values", &SiblingGroup::add_value);
+        port("a", &SiblingGroup::set_a);
+        port("b", &SiblingGroup::set_b);
+    }
+
+    size_t get_log_prob_version() const final {
+        refresh();
+        size_t result = version + version_of(a_version);
+        return (b_ != nullptr) ? result + version_of(b_version) : result;
+    }
+
+    double get_log_prob() final {
+        refresh();
+        return Formula::full_log_prob(a(), b(), values.size(), values.sum, values.sum_log);
+    }
+
+    double get_log_prob_a() final {
+        refresh();
+        return Formula::partial_log_prob_a(a(), b(), values.size(), values.sum, values.sum_log);
+    }
+
+    double get_log_prob_b() final {
+        refresh();
+        return Formula::partial_log_prob_b(a(), b(), values.size(), values.sum, values.sum_log);
+    }
+};
+
+using GammaShapeScaleSiblings =
+    SiblingGroup<GammaShapeScaleSSFormula, IncrementalSums<double, true>>;
+using GammaShapeRateSiblings = SiblingGroup<GammaShapeRateSSFormula, IncrementalSums<double, true>>;
+using PoissonSiblings = SiblingGroup<PoissonSSFormula, IncrementalSums<int, false>>;
+using ExponentialSiblings = SiblingGroup<ExponentialSSFormula, IncrementalSums<double, false>>;
+
+template <class Cell>
+using DenseGammaShapeScaleSiblings = SiblingGroup<GammaShapeScaleSSFormula, DenseSums<Cell, true>>;
+template <class Cell>
+using DenseGammaShapeRateSiblings = SiblingGroup<GammaShapeRateSSFormula, DenseSums<Cell, true>>;
+template <class Cell>
+using DensePoissonSiblings = SiblingGroup<PoissonSSFormula, DenseSums<Cell, false>>;
+template <class Cell>
+using DenseExponentialSiblings = SiblingGroup<ExponentialSSFormula, DenseSums<Cell, false>>;
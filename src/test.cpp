@@ -46,7 +46,301 @@ class MyMean : public Component {
     double mean() { return sum / count; }
 };
 
+// small model whose nodes can all be lowered into a frozen program (see frozen.hpp)
+struct FrozenTestModel : public tc::Composite {
+    static void contents(Model& m, IndexSet& indices, IndexedArray<double>& values) {
+        m.component<OrphanExp>("sigma", 1.0, 1.0);
+        m.component<OrphanNormal>("mu", 0.5, 0.0, 2.0);
+        m.component<Array<Normal>>("x", indices, 0.0)
+            .connect<ArrayToValue>("a", "mu")
+            .connect<ArrayToValue>("b", "sigma")
+            .connect<SetArray<double>>("x", values);
+    }
+};
+
+// moves on a frozen program see the same blanket log prob as moves on components
+void check_frozen_program() {
+    auto indices = make_index_set({"0", "1", "2", "3", "4"});
+    IndexedArray<double> values(indices.dictionary(), 0.0);
+    for (auto i : indices) { values[i] = 0.3 * i - 0.5; }
+    Model m;
+    m.component<FrozenTestModel>("model", indices, values);
+    Assembly a(m);
+    GMIndex index(m.get_composite("model"));
+    FrozenProgram program(a, m, "model", index);
+    if (!program.supported()) {
+        cerr << "Frozen program error: " << program.get_error() << endl;
+        exit(1);
+    }
+    program.publish("mu");
+    FrozenMHMove<Shift> move(program, "mu");
+    move.seed(1, 2);
+    auto terms = program.terms_of("mu");
+    for (int i = 0; i < 100; i++) {
+        move.move(1.0);
+        program.push();
+        double frozen = 0;
+        for (auto& term : terms) { frozen += program.log_prob(term); }
+        double components = a.at<LogProb>(tc::Address("model", "mu")).get_log_prob_x();
+        for (auto e : indices) {
+            components += a.at<LogProb>(tc::Address("model", tc::Address("x", indices.name(e))))
+                              .get_log_prob_a();
+        }
+        if (fabs(frozen - components) > 1e-9) {
+            cerr << "Frozen program error: blanket log prob is " << frozen << " instead of "
+                 << components << endl;
+            exit(1);
+        }
+    }
+    if (!(move.accept_rate() > 0 and move.accept_rate() < 1)) {
+        cerr << "Frozen program error: acceptance rate is " << move.accept_rate() << endl;
+        exit(1);
+    }
+    cout << "Frozen program: blanket log prob matches components" << endl;
+}
+
+// lambda ~ Gamma(shape 2, rate 0.5) and K_i ~ Poisson(c_i * lambda) through product nodes, so that
+// lambda | K ~ Gamma(2 + sum K_i, 0.5 + sum c_i); when dense, lambda is the first cell of a dense
+// array whose second cell has no children
+struct GammaPoissonTestModel : public tc::Composite {
+    static void contents(Model& m, IndexSet& indices, IndexedArray<double>& factors,
+        IndexedArray<int>& counts, bool dense = false) {
+        m.component<Constant<double>>("shape", 2.0);
+        m.component<Constant<double>>("rate", 0.5);
+        m.component<Constant<double>>("one", 1.0);
+        Address lambda("lambda");
+        if (dense) {
+            m.component<DenseArray<DenseGammaSR>>("lambda", make_index_set({"0", "1"}), 1.0)
+                .connect<ArrayToValue>("a", "shape")
+                .connect<ArrayToValue>("b", "rate");
+            lambda = Address("lambda", "0");
+        } else {
+            m.component<GammaSR>("lambda", 1.0)
+                .connect<UseValue>("a", "shape")
+                .connect<UseValue>("b", "rate");
+        }
+        m.component<Array<Constant<double>>>("c", indices, 0.0)
+            .connect<SetArray<double>>("x", factors);
+        m.component<Array<Product>>("c*lambda", indices)
+            .connect<ArrayToValueArray>("a", "c")
+            .connect<ArrayToValue>("b", lambda)
+            .connect<ArrayToValue>("c", "one");
+        m.component<Array<ObservedPoisson>>("K", indices, 0)
+            .connect<ArrayToValueArray>("a", "c*lambda")
+            .connect<SetArray<int>>("x", counts);
+    }
+};
+
+// mu ~ Normal(0, 1) and x_i ~ Normal(mu, s_i), so that mu | x is normal with precision
+// 1 + sum 1/s_i^2 and mean (sum x_i/s_i^2) / precision
+struct NormalNormalTestModel : public tc::Composite {
+    static void contents(Model& m, IndexSet& indices, IndexedArray<double>& std_devs,
+        IndexedArray<double>& values) {
+        m.component<Constant<double>>("mu0", 0.0);
+        m.component<Constant<double>>("sigma0", 1.0);
+        m.component<Normal>("mu", 0.0)
+            .connect<UseValue>("a", "mu0")
+            .connect<UseValue>("b", "sigma0");
+        m.component<Array<Constant<double>>>("s", indices, 0.0)
+            .connect<SetArray<double>>("x", std_devs);
+        m.component<Array<Normal>>("x", indices, 0.0)
+            .connect<ArrayToValue>("a", "mu")
+            .connect<ArrayToValueArray>("b", "s")
+            .connect<SetArray<double>>("x", values);
+    }
+};
+
+// draws of component "move" in m have the given moments on target
+void check_moments(
+    const string& name, Model& m, const tc::Address& target, double mean, double var) {
+    Assembly a(m);
+    auto& move = a.at<Move>("move");
+    move.seed(chain_key(1), stream_of("move"));
+    auto& x = a.at<Value<double>>(target);
+    const int n = 100000;
+    double sum = 0, sum_squares = 0;
+    for (int i = 0; i < n; i++) {
+        move.move();
+        sum += x.get_ref();
+        sum_squares += x.get_ref() * x.get_ref();
+    }
+    double draws_mean = sum / n, draws_var = sum_squares / n - draws_mean * draws_mean;
+    // 5 standard errors for the mean, 5% for the variance (about 5 standard errors as well)
+    if (fabs(draws_mean - mean) > 5 * sqrt(var / n) or fabs(draws_var - var) > 0.05 * var) {
+        cerr << name << " error: draws have mean " << draws_mean << " and variance " << draws_var
+             << " instead of " << mean << " and " << var << endl;
+        exit(1);
+    }
+    cout << name << ": Gibbs draws match posterior moments" << endl;
+}
+
+// Gibbs draws on target (a node of composite "model" in m) have the given posterior moments
+template <class Conjugacy>
+void check_gibbs(const string& name, Model& m, const string& target, double mean, double var) {
+    GMIndex index(m.get_composite("model"));
+    if (!conjugate<Conjugacy>(index, target)) {
+        cerr << name << " error: " << target << " is not recognized as conjugate" << endl;
+        exit(1);
+    }
+    m.component<GibbsMove<Conjugacy>>("move");
+    m.connect<ConnectMove<double, ConnectIndividualGibbs<Conjugacy>>>(
+        tc::PortAddress("target", "move"), tc::Address("model"), tc::Address("model", target),
+        set<tc::Address>{}, &index);
+    check_moments(name, m, tc::Address("model", target), mean, var);
+}
+
+// same with one DenseGibbsMove on both cells of dense array "lambda"; cell 1 has no children, so
+// its draws follow the prior
+void check_dense_gibbs(const string& name, Model& m, double mean, double var) {
+    using Conjugacy = GammaShapeRatePoissonConjugacy;
+    GMIndex index(m.get_composite("model"));
+    m.component<DenseGibbsMove<Conjugacy, GammaShapeRateDistribution>>("move");
+    for (auto cell : {"0", "1"}) {
+        m.connect<ConnectDenseGibbs<Conjugacy, GammaShapeRateDistribution>>(
+            tc::PortAddress("target", "move"), tc::Address("model"),
+            tc::Address("model", "lambda", cell), &index);
+    }
+    check_moments(name, m, tc::Address("model", "lambda", "0"), mean, var);
+    check_moments(name + " (prior)", m, tc::Address("model", "lambda", "1"), 2 / 0.5, 2 / 0.25);
+}
+
+void check_conjugacy() {
+    auto indices = make_index_set({"0", "1", "2"});
+    vector<double> c{0.5, 1.0, 2.0}, s{1.0, 0.5, 2.0}, v{1.0, 2.0, 0.5};
+    vector<int> k{3, 1, 6};
+    IndexedArray<double> factors(indices.dictionary()), std_devs(indices.dictionary()),
+        values(indices.dictionary());
+    IndexedArray<int> counts(indices.dictionary());
+    for (auto i : indices) {
+        factors[i] = c[i];
+        std_devs[i] = s[i];
+        values[i] = v[i];
+        counts[i] = k[i];
+    }
+
+    Model gamma_poisson;
+    gamma_poisson.component<GammaPoissonTestModel>("model", indices, factors, counts);
+    double shape = 2 + 10, rate = 0.5 + 3.5;
+    check_gibbs<GammaShapeRatePoissonConjugacy>(
+        "Gamma-Poisson conjugacy", gamma_poisson, "lambda", shape / rate, shape / (rate * rate));
+
+    Model dense_gamma_poisson;
+    dense_gamma_poisson.component<GammaPoissonTestModel>("model", indices, factors, counts, true);
+    check_dense_gibbs(
+        "Dense Gamma-Poisson conjugacy", dense_gamma_poisson, shape / rate, shape / (rate * rate));
+
+    Model normal_normal;
+    normal_normal.component<NormalNormalTestModel>("model", indices, std_devs, values);
+    double precision = 1 + 1 + 4 + 0.25, weighted_sum = 1 + 8 + 0.125;
+    check_gibbs<NormalNormalConjugacy>(
+        "Normal-Normal conjugacy", normal_normal, "mu", weighted_sum / precision, 1 / precision);
+}
+
+// batch log densities (vectorized, see simd.hpp) sum to the scalar log probs, within a bound
+// relative to the sum of absolute terms (n is not a multiple of the vector width)
+void check_batch_log_probs() {
+    const size_t n = 1003;
+    mt19937_64 engine(1);
+    uniform_real_distribution<double> positive(0.05, 20.0), real(-10.0, 10.0);
+    poisson_distribution<int> counts(30.0);
+    vector<double> x(n), a(n), b(n), y(n), mu(n);
+    vector<int> k(n);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = positive(engine);
+        a[i] = positive(engine);
+        b[i] = positive(engine);
+        y[i] = real(engine);
+        mu[i] = real(engine);
+        k[i] = counts(engine);
+    }
+    auto check = [&](const string& name, double batch, function<double(size_t)> scalar) {
+        double sum = 0, sum_abs = 0;
+        for (size_t i = 0; i < n; i++) {
+            sum += scalar(i);
+            sum_abs += fabs(scalar(i));
+        }
+        if (fabs(batch - sum) > 1e-13 * sum_abs) {
+            cerr << "Batch log prob error: " << name << " is " << batch << " instead of " << sum
+                 << endl;
+            exit(1);
+        }
+    };
+
+    using E = ExponentialDistribution;
+    check("exp full", E::batch_full_log_prob(x.data(), a.data(), n),
+        [&](size_t i) { return E::full_log_prob(x[i], a[i]); });
+    check("exp x", E::batch_partial_log_prob_x(x.data(), a.data(), n),
+        [&](size_t i) { return E::partial_log_prob_x(x[i], a[i]); });
+    check("exp a", E::batch_partial_log_prob_a(x.data(), a.data(), n),
+        [&](size_t i) { return E::partial_log_prob_a(x[i], a[i]); });
+
+    using P = PoissonDistribution;
+    check("poisson full", P::batch_full_log_prob(k.data(), a.data(), n),
+        [&](size_t i) { return P::full_log_prob(k[i], a[i]); });
+    check("poisson x", P::batch_partial_log_prob_x(k.data(), a.data(), n),
+        [&](size_t i) { return P::partial_log_prob_x(k[i], a[i]); });
+    check("poisson a", P::batch_partial_log_prob_a(k.data(), a.data(), n),
+        [&](size_t i) { return P::partial_log_prob_a(k[i], a[i]); });
+
+    using GSS = GammaShapeScaleDistribution;
+    check("gamma ss full", GSS::batch_full_log_prob(x.data(), a.data(), b.data(), n),
+        [&](size_t i) { return GSS::full_log_prob(x[i], a[i], b[i]); });
+    check("gamma ss x", GSS::batch_partial_log_prob_x(x.data(), a.data(), b.data(), n),
+        [&](size_t i) { return GSS::partial_log_prob_x(x[i], a[i], b[i]); });
+    check("gamma ss a", GSS::batch_partial_log_prob_a(x.data(), a.data(), b.data(), n),
+        [&](size_t i) { return GSS::partial_log_prob_a(x[i], a[i], b[i]); });
+    check("gamma ss b", GSS::batch_partial_log_prob_b(x.data(), a.data(), b.data(), n),
+        [&](size_t i) { return GSS::partial_log_prob_b(x[i], a[i], b[i]); });
+
+    using GSR = GammaShapeRateDistribution;
+    check("gamma sr full", GSR::batch_full_log_prob(x.data(), a.data(), b.data(), n),
+        [&](size_t i) { return GSR::full_log_prob(x[i], a[i], b[i]); });
+    check("gamma sr x", GSR::batch_partial_log_prob_x(x.data(), a.data(), b.data(), n),
+        [&](size_t i) { return GSR::partial_log_prob_x(x[i], a[i], b[i]); });
+    check("gamma sr a", GSR::batch_partial_log_prob_a(x.data(), a.data(), b.data(), n),
+        [&](size_t i) { return GSR::partial_log_prob_a(x[i], a[i], b[i]); });
+    check("gamma sr b", GSR::batch_partial_log_prob_b(x.data(), a.data(), b.data(), n),
+        [&](size_t i) { return GSR::partial_log_prob_b(x[i], a[i], b[i]); });
+
+    using N = NormalDistribution;
+    check("normal full", N::batch_full_log_prob(y.data(), mu.data(), b.data(), n),
+        [&](size_t i) { return N::full_log_prob(y[i], mu[i], b[i]); });
+    check("normal x", N::batch_partial_log_prob_x(y.data(), mu.data(), b.data(), n),
+        [&](size_t i) { return N::partial_log_prob_x(y[i], mu[i], b[i]); });
+    check("normal a", N::batch_partial_log_prob_a(y.data(), mu.data(), b.data(), n),
+        [&](size_t i) { return N::partial_log_prob_a(y[i], mu[i], b[i]); });
+    check("normal b", N::batch_partial_log_prob_b(y.data(), mu.data(), b.data(), n),
+        [&](size_t i) { return N::partial_log_prob_b(y[i], mu[i], b[i]); });
+
+    cout << "Batch log probs (vector width " << simd::width << "): sums match scalar log probs"
+         << endl;
+}
+
+// known-answer vectors of Philox4x32-10 (from the Random123 distribution)
+void check_philox() {
+    struct Vector {
+        uint64_t key, stream, position;
+        philox::Block expected;
+    };
+    vector<Vector> vectors{{0, 0, 0, {{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}}},
+        {~0ull, ~0ull, ~0ull, {{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}}},
+        {0x299f31d0a4093822ull, 0x0370734413198a2eull, 0x85a308d3243f6a88ull,
+            {{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}}}};
+    for (auto& v : vectors) {
+        if (philox::block(v.key, v.stream, v.position) != v.expected) {
+            cerr << "Philox error: wrong block for key " << hex << v.key << endl;
+            exit(1);
+        }
+    }
+    cout << "Philox: known-answer vectors match" << endl;
+}
+
 int main() {
+    check_philox();
+    check_frozen_program();
+    check_conjugacy();
+    check_batch_log_probs();
+
     Model m;
     m.component<OrphanExp>("k", 0.5, 1.0);
     m.component<OrphanExp>("theta", 0.5, 1.0);
@@ -88,6 +382,7 @@ int main() {
      }).connect("move1", "move2", "k", "theta", "meank", "meantheta");
 
     Assembly a(m);
+    for (auto move : {"move1", "move2"}) { a.at<Move>(move).seed(chain_key(1), stream_of(move)); }
     a.at<Proxy>("gammasuffstat").acquire();
     a.call("movescheduler", "go");
 }
@@ -27,6 +27,11 @@ license and that you accept its terms.*/
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <thread>
 #include <vector>
 #include "computing_entity.hpp"
@@ -50,4 +55,84 @@ Threads spawn(int rank_start, int rank_end, F f, Args... args) {
 
 void join(Threads& threads) {
     for (auto&& t : threads) { t.join(); }
-}
\ No newline at end of file
+}
+
+/*
+====================================================================================================
+  ~*~ ThreadPool ~*~
+  Persistent worker threads used to run parallel loops. Iterations are handed out in small chunks
+  through a shared counter so that threads that finish early pick up the remaining work. The
+  calling thread takes part in the loop.
+==================================================================================================*/
+class ThreadPool {
+    Threads workers;
+    std::mutex mutex;
+    std::condition_variable work_ready, work_done;
+    std::function<void(size_t)> body;
+    size_t size{0}, chunk{1};
+    std::atomic<size_t> next{0};
+    int generation{0}, nb_busy{0};
+    bool stop{false};
+
+    void run_chunks() {
+        size_t start;
+        while ((start = next.fetch_add(chunk)) < size) {
+            size_t end = std::min(start + chunk, size);
+            for (size_t i = start; i < end; i++) { body(i); }
+        }
+    }
+
+    void worker_loop() {
+        int seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work_ready.wait(lock, [&]() { return stop or generation != seen; });
+                if (stop) { return; }
+                seen = generation;
+            }
+            run_chunks();
+            std::unique_lock<std::mutex> lock(mutex);
+            if (--nb_busy == 0) { work_done.notify_one(); }
+        }
+    }
+
+  public:
+    ThreadPool(int nb_threads) {
+        for (int i = 1; i < nb_threads; i++) { workers.emplace_back([this]() { worker_loop(); }); }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stop = true;
+        }
+        work_ready.notify_all();
+        join(workers);
+    }
+
+    int nb_threads() const { return workers.size() + 1; }
+
+    // calls f(i) for all i in [0, n) and returns when all calls have completed
+    void parallel_for(size_t n, std::function<void(size_t)> f) {
+        if (workers.empty()) {
+            for (size_t i = 0; i < n; i++) { f(i); }
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            body = f;
+            size = n;
+            chunk = std::max<size_t>(1, n / (8 * nb_threads()));
+            next = 0;
+            nb_busy = workers.size();
+            generation++;
+        }
+        work_ready.notify_all();
+        run_chunks();
+        std::unique_lock<std::mutex> lock(mutex);
+        work_done.wait(lock, [&]() { return nb_busy == 0; });
+    }
+};
@@ -27,12 +27,33 @@ license and that you accept its terms.*/
 
 #pragma once
 
+#include <atomic>
 #include <cstdio>
 #include <random>
-
-std::random_device r;
-std::default_random_engine generator(r());
-std::uniform_real_distribution<double> uniform{0.0, 1.0};
-bool decide(double prob) { return uniform(generator) <= prob; }
+#include "random.hpp"
+
+/*
+====================================================================================================
+  ~*~ Global seed and per-thread streams ~*~
+  Moves use their own streams (see MCMC::seed). Other random draws go through a stream per thread,
+  all derived from the global seed; threads get their stream number in order of first use.
+==================================================================================================*/
+uint64_t global_seed = std::random_device()();
+std::atomic<uint64_t> nb_thread_streams{0};
+
+RandomStream make_thread_stream() {
+    return RandomStream(chain_key(global_seed), ~uint64_t(0) - nb_thread_streams++);
+}
+
+thread_local RandomStream generator = make_thread_stream();
+
+// to be called before starting other threads
+void set_global_seed(uint64_t seed) {
+    global_seed = seed;
+    nb_thread_streams = 0;
+    generator = make_thread_stream();
+}
+
+bool decide(double prob) { return generator.decide(prob); }
 
 double log_factorial(int n) { return std::lgamma(n + 1); }